@@ -6,9 +6,17 @@
  * (c) 2020, Vladikcomper															 *
  * ================================================================================= */
 
+#define _POSIX_C_SOURCE 200112L
+#define _DARWIN_C_SOURCE		// for "_SC_NPROCESSORS_ONLN", which isn't POSIX (macOS)
+#define _DEFAULT_SOURCE			// same for glibc
+
 #include <stdlib.h>		// for "malloc"
 #include <stdio.h>		// for "size_t", "printf" etc
 #include <stdint.h>		// for "uint8_t" etc.
+#include <string.h>		// for "memcmp", "memcpy"
+#include <pthread.h>	// for portfolio compression threads
+#include <time.h>		// for "clock_gettime"
+#include <unistd.h>		// for "sysconf"
 
 #include "lzkn.h"
 
@@ -111,22 +119,29 @@ lz_error lzkn1_compress(const uint8_t *inBuff, const size_t inBuffSize, uint8_t
 				queuedRawCopySize = inBuffSize - inBuffLastCopyPos;
 			}
 
-			// When transferring more than 8 bytes, use "FLAG_COPY_RAW" flag instead of plain bit fields
-			if (queuedRawCopySize > 8) {
-				PUSH_DESC_FIELD_BIT(BYTE_FLAG);					// set the following data as a flag
-				outBuff[outBuffPos++] = (FLAG_COPY_RAW) | (queuedRawCopySize - 8);
+			// On the last cycle, the queue may exceed a single "FLAG_COPY_RAW" by one byte, so transfer it in chunks
+			while (queuedRawCopySize > 0) {
+				const int32_t transferSize = MIN(queuedRawCopySize, 0x47);
+
+				// When transferring more than 8 bytes, use "FLAG_COPY_RAW" flag instead of plain bit fields
+				if (transferSize > 8) {
+					PUSH_DESC_FIELD_BIT(BYTE_FLAG);					// set the following data as a flag
+					outBuff[outBuffPos++] = (FLAG_COPY_RAW) | (transferSize - 8);
 
-				for (int32_t i = 0; i < queuedRawCopySize; ++i) {
-					outBuff[outBuffPos++] = inBuff[inBuffLastCopyPos++];
+					for (int32_t i = 0; i < transferSize; ++i) {
+						outBuff[outBuffPos++] = inBuff[inBuffLastCopyPos++];
+					}
 				}
-			}
 
-			// If less than 8 bytes should be transferred, store raw bytes info in the description field directly ...
-			else {
-				for (int32_t i = 0; i < queuedRawCopySize; ++i) {
-					PUSH_DESC_FIELD_BIT(BYTE_RAW);
-					outBuff[outBuffPos++] = inBuff[inBuffLastCopyPos++];
+				// If less than 8 bytes should be transferred, store raw bytes info in the description field directly ...
+				else {
+					for (int32_t i = 0; i < transferSize; ++i) {
+						PUSH_DESC_FIELD_BIT(BYTE_RAW);
+						outBuff[outBuffPos++] = inBuff[inBuffLastCopyPos++];
+					}
 				}
+
+				queuedRawCopySize -= transferSize;
 			}
 		}
 
@@ -193,7 +208,7 @@ lz_error lzkn1_decompress(uint8_t *inBuff, size_t inBuffSize, uint8_t** outBuffP
 
 	// Get uncompressed buffer size and allocate the buffer
 	size_t outBuffSize = (inBuff[inBuffPos] << 8) + inBuff[inBuffPos+1];
-	uint8_t *outBuff = malloc(outBuffSize);
+	uint8_t *outBuff = malloc(outBuffSize ? outBuffSize : 1);		// "malloc(0)" may return NULL
 	inBuffPos += 2;
 
 	if (!outBuff) {
@@ -279,3 +294,1149 @@ lz_error lzkn1_decompress(uint8_t *inBuff, size_t inBuffSize, uint8_t** outBuffP
 
 	return result;
 }
+
+
+
+/* ================================================================================= *
+ * Parse strategies and portfolio ("max") compression								 *
+ * ================================================================================= */
+
+#define WINDOW_SIZE			0x3FF		// Mode 1 maximum displacement
+#define MODE1_MAX_COPY		0x21		// Mode 1 maximum copy size
+#define MODE1_FAR_MAX_COPY	0x22		// Mode 1 maximum copy size for displacements with high bits set
+#define MODE1_FAR_MIN_DISP	0x100		// smaller displacements can't copy 34 bytes (the flag would read $1F)
+#define MODE2_WINDOW_SIZE	0xF			// Mode 2 maximum displacement
+#define MODE2_MAX_COPY		5			// Mode 2 maximum copy size
+#define RAW_RUN_MIN			8			// "FLAG_COPY_RAW" minimum transfer size
+#define RAW_RUN_MAX			0x47		// "FLAG_COPY_RAW" maximum transfer size
+
+#define TOKEN_RAW			0			// single raw byte (description field bit = 0)
+#define TOKEN_RAW_RUN		1			// "FLAG_COPY_RAW"
+#define TOKEN_MODE1			2			// "FLAG_COPY_MODE1"
+#define TOKEN_MODE2			3			// "FLAG_COPY_MODE2"
+
+#define CANCEL_POLL_MASK	0xFF		// strategies poll for cancellation every 256 positions
+#define QUICK_CHAIN_DEPTH	8			// match finder depth for the quick pass of time-bounded compression
+
+#define ADLER_MOD			65521		// largest prime below 2^16
+#define ADLER_NMAX			5552		// bytes which can be summed before the Adler-32 modulo is due
+#define VERIFY_RING			0x400		// verification ring size, holds the whole Mode 1 window
+
+/* Longest matches available at a given input position */
+typedef struct {
+	uint8_t size;			// longest match size within the window (0 if none)
+	uint8_t nearSize;		// longest match size within Mode 2 reach, capped at "MODE2_MAX_COPY"
+	uint16_t disp;			// displacement of the nearest longest match
+	uint8_t nearDisp;		// displacement of the nearest Mode 2 match
+	uint16_t farDisp;		// displacement of the nearest "MODE1_FAR_MAX_COPY" match (0 if none)
+} lzkn1_match;
+
+/* Single unit of the compressed stream */
+typedef struct {
+	uint8_t type;			// one of "TOKEN_*"
+	uint8_t size;			// number of uncompressed bytes covered
+	uint16_t disp;			// copy displacement (copy tokens only)
+} lzkn1_token;
+
+/* Compressor/decompressor context, owns all working memory */
+struct lzkn1_ctx {
+	int32_t base;						// hash chain entries below this value are stale
+	int32_t head[0x10000];				// last position (+ "base") for each 2-byte key
+	int32_t prev[0x10000];				// previous position (+ "base") with the same key
+	lzkn1_match matches[0x10000];
+	lzkn1_token tokens[0x10001];
+	uint32_t * cost;					// optimal parse state costs, allocated on the first use
+	uint16_t * choice;					// optimal parse state choices, allocated on the first use
+	uint8_t scratch[LZKN1_COMPRESS_BOUND(0xFFFF)];	// candidate stream for time-bounded compression
+	struct lzkn1_ctx * workers[LZKN1_STRATEGY_COUNT - 1];	// portfolio job contexts, created on the first use
+};
+
+/* Match finder state for a single input */
+typedef struct {
+	lzkn1_ctx * ctx;
+	const uint8_t * inBuff;
+	int32_t inBuffSize;
+	int32_t base;					// hash chain base for this input
+	int32_t maxChainDepth;			// maximum candidates to check per position (0 = unlimited)
+	int32_t nextInsertPos;			// positions below this are in the hash chains
+	int32_t nextSearchPos;			// positions below this have been searched (if requested)
+	const lzkn1_match * matches;
+} lzkn1_matcher;
+
+/* Token list builder, which queues raw bytes and flushes them in the cheapest form */
+typedef struct {
+	lzkn1_token * tokens;
+	size_t numTokens;
+	size_t rawQueueSize;
+} lzkn1_parser;
+
+/* Cancellation flag shared between portfolio threads, with an optional deadline */
+typedef struct {
+	pthread_mutex_t mutex;
+	int cancelled;
+	int hasDeadline;
+	struct timespec deadline;
+} lzkn1_cancel;
+
+/* Portfolio job, one per strategy */
+typedef struct {
+	lzkn1_strategy strategy;
+	lzkn1_ctx * ctx;
+	const uint8_t * inBuff;
+	size_t inBuffSize;
+	lzkn1_matcher matcher;
+	lzkn1_cancel * cancel;
+	uint8_t * outBuff;
+	size_t outBuffSize;
+	size_t compressedSize;
+	lz_error result;
+} lzkn1_job;
+
+/* Decoder output, either the whole buffer or a ring with a running Adler-32 */
+typedef struct {
+	uint8_t * buff;
+	size_t mask;					// "SIZE_MAX" for a linear buffer, ring size - 1 otherwise
+	int checksummed;				// update "adlerA"/"adlerB" for every byte written
+	uint32_t adlerA;
+	uint32_t adlerB;
+	size_t adlerPending;			// bytes summed since the last modulo
+} lzkn1_sink;
+
+static const char * strategyNames[LZKN1_STRATEGY_COUNT] = {
+	"greedy", "lazy", "optimal", "mode2", "raw"
+};
+
+/**
+ * Returns a human-readable strategy name
+ */
+const char * lzkn1_strategy_name(lzkn1_strategy strategy) {
+	if ((unsigned)strategy >= LZKN1_STRATEGY_COUNT) {
+		return "unknown";
+	}
+
+	return strategyNames[strategy];
+}
+
+static int lzkn1_is_cancelled(lzkn1_cancel *cancel) {
+	if (cancel == NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&cancel->mutex);
+	int cancelled = cancel->cancelled;
+	pthread_mutex_unlock(&cancel->mutex);
+
+	if (!cancelled && cancel->hasDeadline) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		cancelled = (now.tv_sec > cancel->deadline.tv_sec)
+			|| ((now.tv_sec == cancel->deadline.tv_sec) && (now.tv_nsec >= cancel->deadline.tv_nsec));
+	}
+
+	return cancelled;
+}
+
+static void lzkn1_set_cancelled(lzkn1_cancel *cancel) {
+	pthread_mutex_lock(&cancel->mutex);
+	cancel->cancelled = 1;
+	pthread_mutex_unlock(&cancel->mutex);
+}
+
+/**
+ * Prepares match finder for the new input
+ * 
+ * Uses hash chains keyed by the first two bytes. Chains are walked from the nearest
+ * position outwards, so ties resolve exactly as in "lzkn1_compress".
+ * 
+ * Positions are stored with the context's base added, which moves forward after each
+ * call. This invalidates all entries at once, so the tables are only cleared when
+ * the base is about to overflow.
+ * 
+ * If "maxChainDepth" is non-zero, at most that many candidates are checked for each
+ * position, which trades ratio for speed.
+ */
+static void lzkn1_matcher_init(lzkn1_matcher *matcher, lzkn1_ctx *ctx, const uint8_t *inBuff, size_t inBuffSize, int32_t maxChainDepth) {
+
+	if (ctx->base > INT32_MAX - 0x20000) {
+		lzkn1_reset_ctx(ctx);
+	}
+
+	matcher->ctx = ctx;
+	matcher->inBuff = inBuff;
+	matcher->inBuffSize = inBuffSize;
+	matcher->base = ctx->base;
+	matcher->maxChainDepth = maxChainDepth;
+	matcher->nextInsertPos = 0;
+	matcher->nextSearchPos = 0;
+	matcher->matches = ctx->matches;
+
+	ctx->base += inBuffSize + 1;
+}
+
+/* Adds position to the hash chains */
+static void lzkn1_matcher_insert(lzkn1_matcher *matcher, int32_t pos) {
+
+	if (pos + 1 < matcher->inBuffSize) {
+		const uint16_t key = (matcher->inBuff[pos] << 8) | matcher->inBuff[pos + 1];
+
+		matcher->ctx->prev[pos] = matcher->ctx->head[key];
+		matcher->ctx->head[key] = pos + matcher->base;
+	}
+}
+
+/* Finds the longest matches at the given position, all previous positions should be inserted */
+static void lzkn1_matcher_search(lzkn1_matcher *matcher, int32_t pos) {
+
+	const uint8_t * inBuff = matcher->inBuff;
+	const int32_t base = matcher->base;
+	const int32_t * head = matcher->ctx->head;
+	const int32_t * prev = matcher->ctx->prev;
+	lzkn1_match * match = &matcher->ctx->matches[pos];
+
+	match->size = 0;
+	match->disp = 0;
+	match->nearSize = 0;
+	match->nearDisp = 0;
+	match->farDisp = 0;
+
+	if (pos + 1 >= matcher->inBuffSize) {
+		return;
+	}
+
+	const int32_t maxCopy = MIN(MODE1_MAX_COPY, matcher->inBuffSize - pos);
+	const int32_t farMaxCopy = MIN(MODE1_FAR_MAX_COPY, matcher->inBuffSize - pos);
+	const int32_t nearMaxCopy = MIN(MODE2_MAX_COPY, maxCopy);
+	const uint16_t key = (inBuff[pos] << 8) | inBuff[pos + 1];
+	int32_t chainDepth = matcher->maxChainDepth;
+
+	for (int32_t matchPos = head[key] - base; (matchPos >= 0) && (pos - matchPos <= WINDOW_SIZE); matchPos = prev[matchPos] - base) {
+		const int32_t disp = pos - matchPos;
+		const int32_t candidateMaxCopy = (disp >= MODE1_FAR_MIN_DISP) ? farMaxCopy : maxCopy;
+		const int32_t bestSize = match->farDisp ? farMaxCopy : match->size;
+		int32_t currentMatchSize = 2;
+
+		// Unless Mode 2 match may still improve, skip candidates which can't be longer than the current one
+		if (((disp > MODE2_WINDOW_SIZE) || (match->nearSize == nearMaxCopy)) && (bestSize >= 2)
+				&& ((bestSize >= candidateMaxCopy) || (inBuff[matchPos + bestSize] != inBuff[pos + bestSize]))) {
+			if (--chainDepth == 0) {
+				break;
+			}
+			continue;
+		}
+
+		while ((currentMatchSize < candidateMaxCopy) && (inBuff[matchPos + currentMatchSize] == inBuff[pos + currentMatchSize])) {
+			++currentMatchSize;
+		}
+
+		// Nearest longest match is kept within "MODE1_MAX_COPY", so greedy parse matches "lzkn1_compress"
+		if (MIN(currentMatchSize, maxCopy) > match->size) {
+			match->size = MIN(currentMatchSize, maxCopy);
+			match->disp = disp;
+		}
+
+		if ((currentMatchSize == MODE1_FAR_MAX_COPY) && (match->farDisp == 0)) {
+			match->farDisp = disp;
+		}
+
+		if ((disp <= MODE2_WINDOW_SIZE) && (MIN(currentMatchSize, nearMaxCopy) > match->nearSize)) {
+			match->nearSize = MIN(currentMatchSize, nearMaxCopy);
+			match->nearDisp = disp;
+		}
+
+		// Stop once neither match can improve
+		if (((match->farDisp ? farMaxCopy : match->size) == farMaxCopy) && ((disp >= MODE2_WINDOW_SIZE) || (match->nearSize == nearMaxCopy))) {
+			break;
+		}
+		if (--chainDepth == 0) {
+			break;
+		}
+	}
+}
+
+/**
+ * Returns the longest matches at the given position
+ * 
+ * Positions should be requested in non-decreasing order. Only requested positions
+ * are searched, the rest are merely inserted into the hash chains.
+ */
+static const lzkn1_match * lzkn1_match_at(lzkn1_matcher *matcher, int32_t pos) {
+
+	if (pos >= matcher->nextSearchPos) {
+		for (; matcher->nextInsertPos < pos; ++matcher->nextInsertPos) {
+			lzkn1_matcher_insert(matcher, matcher->nextInsertPos);
+		}
+
+		lzkn1_matcher_search(matcher, pos);
+		matcher->nextSearchPos = pos + 1;
+	}
+
+	return &matcher->matches[pos];
+}
+
+/**
+ * Finds the longest matches for every remaining input position
+ */
+static lz_error lzkn1_find_matches(lzkn1_matcher *matcher, lzkn1_cancel *cancel) {
+
+	for (int32_t pos = matcher->nextSearchPos; pos < matcher->inBuffSize; ++pos) {
+		if (((pos & CANCEL_POLL_MASK) == 0) && lzkn1_is_cancelled(cancel)) {
+			return LZ_CANCELLED;
+		}
+
+		lzkn1_match_at(matcher, pos);
+	}
+
+	return 0;
+}
+
+static void lzkn1_parser_push(lzkn1_parser *parser, uint8_t type, int32_t size, int32_t disp) {
+	lzkn1_token * token = &parser->tokens[parser->numTokens++];
+
+	token->type = type;
+	token->size = size;
+	token->disp = disp;
+}
+
+/* Renders queued raw bytes: "FLAG_COPY_RAW" for more than 8 bytes, description field bits otherwise */
+static void lzkn1_parser_flush(lzkn1_parser *parser) {
+	if (parser->rawQueueSize > RAW_RUN_MIN) {
+		lzkn1_parser_push(parser, TOKEN_RAW_RUN, parser->rawQueueSize, 0);
+	}
+	else {
+		for (size_t i = 0; i < parser->rawQueueSize; ++i) {
+			lzkn1_parser_push(parser, TOKEN_RAW, 1, 0);
+		}
+	}
+
+	parser->rawQueueSize = 0;
+}
+
+static void lzkn1_parser_raw(lzkn1_parser *parser) {
+	if (++parser->rawQueueSize >= RAW_RUN_MAX) {
+		lzkn1_parser_flush(parser);
+	}
+}
+
+static void lzkn1_parser_copy(lzkn1_parser *parser, uint8_t type, int32_t size, int32_t disp) {
+	lzkn1_parser_flush(parser);
+	lzkn1_parser_push(parser, type, size, disp);
+}
+
+/* Longest Mode 1 copy available, including far 34-byte copies */
+#define MODE1_SIZE(match)	((match)->farDisp ? MODE1_FAR_MAX_COPY : (match)->size)
+#define MODE1_DISP(match)	((match)->farDisp ? (match)->farDisp : (match)->disp)
+
+/* Bytes saved by a copy token compared to the same number of raw bytes */
+#define MODE1_GAIN(match)	(MODE1_SIZE(match) >= 3 ? MODE1_SIZE(match) - 2 : 0)
+#define MODE2_GAIN(match)	((match)->nearSize >= 2 ? (match)->nearSize - 1 : 0)
+
+/**
+ * Heuristic (single-pass) strategies: greedy, lazy, Mode 2 and raw biased
+ */
+static lz_error lzkn1_parse_heuristic(lzkn1_strategy strategy, lzkn1_matcher *matcher, lzkn1_parser *parser, lzkn1_cancel *cancel) {
+
+	const int32_t inBuffSize = matcher->inBuffSize;
+	int32_t inBuffPos = 0;
+
+	while (inBuffPos < inBuffSize) {
+
+		if (((inBuffPos & CANCEL_POLL_MASK) == 0) && lzkn1_is_cancelled(cancel)) {
+			return LZ_CANCELLED;
+		}
+
+		const lzkn1_match * match = lzkn1_match_at(matcher, inBuffPos);
+		uint8_t suggestedMode = 0xFF;
+
+		if (strategy == LZKN1_STRATEGY_GREEDY) {
+			if ((match->size >= 2) && (match->size <= MODE2_MAX_COPY) && (match->disp <= MODE2_WINDOW_SIZE)) {
+				suggestedMode = TOKEN_MODE2;
+			}
+			else if (match->size >= 3) {
+				suggestedMode = TOKEN_MODE1;
+			}
+		}
+		else {
+			// Pick the copy that saves the most bytes, Mode 2 wins ties
+			const int32_t mode1Gain = MODE1_GAIN(match);
+			const int32_t mode2Gain = MODE2_GAIN(match);
+			int32_t gain = 0;
+
+			if ((mode2Gain > 0) && (mode2Gain >= mode1Gain)) {
+				suggestedMode = TOKEN_MODE2;
+				gain = mode2Gain;
+			}
+			else if (mode1Gain > 0) {
+				suggestedMode = TOKEN_MODE1;
+				gain = mode1Gain;
+			}
+
+			// Lazy: emit a raw byte if the next position offers a better copy
+			if ((strategy == LZKN1_STRATEGY_LAZY) && (suggestedMode != 0xFF) && (inBuffPos + 1 < inBuffSize)) {
+				const lzkn1_match * nextMatch = lzkn1_match_at(matcher, inBuffPos + 1);
+
+				if (MAX(MODE1_GAIN(nextMatch), MODE2_GAIN(nextMatch)) > gain) {
+					suggestedMode = 0xFF;
+				}
+			}
+
+			// Raw biased: don't break a raw run for a copy saving a single byte
+			if ((strategy == LZKN1_STRATEGY_RAW) && (parser->rawQueueSize >= RAW_RUN_MIN) && (gain <= 1)) {
+				suggestedMode = 0xFF;
+			}
+		}
+
+		if (suggestedMode == TOKEN_MODE2) {
+			const int32_t size = (strategy == LZKN1_STRATEGY_GREEDY) ? match->size : match->nearSize;
+			const int32_t disp = (strategy == LZKN1_STRATEGY_GREEDY) ? match->disp : match->nearDisp;
+
+			lzkn1_parser_copy(parser, TOKEN_MODE2, size, disp);
+			inBuffPos += size;
+		}
+		else if (suggestedMode == TOKEN_MODE1) {
+			const int32_t size = (strategy == LZKN1_STRATEGY_GREEDY) ? match->size : MODE1_SIZE(match);
+			const int32_t disp = (strategy == LZKN1_STRATEGY_GREEDY) ? match->disp : MODE1_DISP(match);
+
+			lzkn1_parser_copy(parser, TOKEN_MODE1, size, disp);
+			inBuffPos += size;
+		}
+		else {
+			lzkn1_parser_raw(parser);
+			inBuffPos += 1;
+		}
+	}
+
+	lzkn1_parser_flush(parser);
+
+	return 0;
+}
+
+/**
+ * Optimal strategy
+ * 
+ * Finds the shortest stream over all token sequences. Since description fields cost
+ * a whole byte every 8 tokens, the state is the input position and the token count
+ * modulo 8, which makes the result exact rather than a bit-cost approximation.
+ */
+static lz_error lzkn1_parse_optimal(lzkn1_ctx *ctx, lzkn1_matcher *matcher, lzkn1_parser *parser, lzkn1_cancel *cancel) {
+
+	// Every position is needed here
+	if (lzkn1_find_matches(matcher, cancel) != 0) {
+		return LZ_CANCELLED;
+	}
+
+	const size_t inBuffSize = matcher->inBuffSize;
+	const lzkn1_match * matches = matcher->matches;
+
+	#define STATE(pos, phase)	((size_t)(pos) * 8 + (phase))
+	#define TOKEN_CHOICE(type, size)	(((type) << 8) | (size))
+
+	const size_t numStates = STATE(inBuffSize + 1, 0);
+	const uint32_t infinity = UINT32_MAX;
+
+	// State tables are sized for the largest possible input, so they're allocated only once
+	if (!ctx->cost || !ctx->choice) {
+		free(ctx->cost);
+		free(ctx->choice);
+		ctx->cost = malloc(STATE(0x10000, 0) * sizeof(uint32_t));
+		ctx->choice = malloc(STATE(0x10000, 0) * sizeof(uint16_t));
+
+		if (!ctx->cost || !ctx->choice) {
+			return LZ_ALLOC_FAILED;
+		}
+	}
+
+	uint32_t * cost = ctx->cost;
+	uint16_t * choice = ctx->choice;
+
+	for (size_t i = 0; i < numStates; ++i) {
+		cost[i] = infinity;
+	}
+	cost[STATE(0, 0)] = 0;
+
+	#define RELAX(pos, phase, type, size, tokenCost) { \
+			const size_t nextState = STATE((pos) + (size), ((phase) + 1) & 7); \
+			const uint32_t nextCost = cost[STATE(pos, phase)] + ((phase) == 0) + (tokenCost); \
+			if (nextCost < cost[nextState]) { \
+				cost[nextState] = nextCost; \
+				choice[nextState] = TOKEN_CHOICE(type, size); \
+			} \
+		}
+
+	for (int32_t pos = 0; pos < (int32_t)inBuffSize; ++pos) {
+
+		if (((pos & CANCEL_POLL_MASK) == 0) && lzkn1_is_cancelled(cancel)) {
+			return LZ_CANCELLED;
+		}
+
+		const lzkn1_match * match = &matches[pos];
+		const int32_t maxRawRun = MIN(RAW_RUN_MAX, (int32_t)inBuffSize - pos);
+
+		for (int32_t phase = 0; phase < 8; ++phase) {
+			if (cost[STATE(pos, phase)] == infinity) {
+				continue;
+			}
+
+			RELAX(pos, phase, TOKEN_RAW, 1, 1);
+
+			for (int32_t size = 2; size <= match->nearSize; ++size) {
+				RELAX(pos, phase, TOKEN_MODE2, size, 1);
+			}
+			for (int32_t size = 3; size <= MODE1_SIZE(match); ++size) {
+				RELAX(pos, phase, TOKEN_MODE1, size, 2);
+			}
+			for (int32_t size = RAW_RUN_MIN; size <= maxRawRun; ++size) {
+				RELAX(pos, phase, TOKEN_RAW_RUN, size, 1 + size);
+			}
+		}
+	}
+
+	// Account for the stop flag, then pick the best final phase
+	int32_t bestPhase = 0;
+	uint32_t bestCost = infinity;
+
+	for (int32_t phase = 0; phase < 8; ++phase) {
+		const uint32_t finalCost = cost[STATE(inBuffSize, phase)];
+
+		if ((finalCost != infinity) && (finalCost + (phase == 0) < bestCost)) {
+			bestCost = finalCost + (phase == 0);
+			bestPhase = phase;
+		}
+	}
+
+	// Walk the choices backwards to recover the token count, then fill tokens in order
+	size_t numTokens = 0;
+
+	for (size_t pos = inBuffSize, phase = bestPhase; pos > 0; phase = (phase + 7) & 7) {
+		pos -= choice[STATE(pos, phase)] & 0xFF;
+		++numTokens;
+	}
+
+	size_t tokenId = numTokens;
+
+	for (size_t pos = inBuffSize, phase = bestPhase; pos > 0; phase = (phase + 7) & 7) {
+		const uint8_t type = choice[STATE(pos, phase)] >> 8;
+		const uint8_t size = choice[STATE(pos, phase)] & 0xFF;
+		lzkn1_token * token = &parser->tokens[--tokenId];
+
+		pos -= size;
+
+		token->type = type;
+		token->size = size;
+		token->disp = (type == TOKEN_MODE1) ? ((size == MODE1_FAR_MAX_COPY) ? matches[pos].farDisp : matches[pos].disp)
+			: (type == TOKEN_MODE2) ? matches[pos].nearDisp : 0;
+	}
+
+	parser->numTokens = numTokens;
+
+	#undef RELAX
+	#undef TOKEN_CHOICE
+	#undef STATE
+
+	return 0;
+}
+
+/**
+ * Renders token list into the compressed stream, including header and stop flag
+ */
+static lz_error lzkn1_emit(const uint8_t *inBuff, size_t inBuffSize, const lzkn1_token *tokens, size_t numTokens, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize) {
+
+	size_t inBuffPos = 0;
+	size_t outBuffPos = 0;
+
+	uint8_t * descFieldPtr = NULL;
+	int descFieldCurrentBit = 0;
+
+	if (outBuffSize < 2) {
+		return LZ_OUTBUFF_OVERFLOW;
+	}
+
+	outBuff[outBuffPos++] = inBuffSize >> 8;
+	outBuff[outBuffPos++] = inBuffSize & 0xFF;
+
+	for (size_t tokenId = 0; tokenId <= numTokens; ++tokenId) {
+		const lzkn1_token * token = (tokenId < numTokens) ? &tokens[tokenId] : NULL;
+		const size_t tokenSize = 
+			(token == NULL) ? 1 :
+			(token->type == TOKEN_RAW_RUN) ? 1 + token->size :
+			(token->type == TOKEN_MODE1) ? 2 : 1;
+
+		if (outBuffPos + (descFieldPtr == NULL) + tokenSize > outBuffSize) {
+			return LZ_OUTBUFF_OVERFLOW;
+		}
+
+		const uint8_t bit = (token && token->type == TOKEN_RAW) ? BYTE_RAW : BYTE_FLAG;
+		PUSH_DESC_FIELD_BIT(bit);
+
+		if (token == NULL) {
+			outBuff[outBuffPos++] = 0x1F;
+		}
+		else if (token->type == TOKEN_RAW) {
+			outBuff[outBuffPos++] = inBuff[inBuffPos++];
+		}
+		else if (token->type == TOKEN_RAW_RUN) {
+			outBuff[outBuffPos++] = (FLAG_COPY_RAW) | (token->size - RAW_RUN_MIN);
+			memcpy(outBuff + outBuffPos, inBuff + inBuffPos, token->size);
+			outBuffPos += token->size;
+			inBuffPos += token->size;
+		}
+		else if (token->type == TOKEN_MODE1) {
+			outBuff[outBuffPos++] = (FLAG_COPY_MODE1) | ((token->disp & 0x300) >> 3) | (token->size - 3);
+			outBuff[outBuffPos++] = (token->disp & 0xFF);
+			inBuffPos += token->size;
+		}
+		else {
+			outBuff[outBuffPos++] = (FLAG_COPY_MODE2) | (token->disp & 0xF) | ((token->size - 2) << 4);
+			inBuffPos += token->size;
+		}
+	}
+
+	if (inBuffPos != inBuffSize) {
+		return (inBuffPos > inBuffSize) ? LZ_INBUFF_OVERFLOW : LZ_INBUFF_UNDERFLOW;
+	}
+
+	*compressedSize = outBuffPos;
+
+	return 0;
+}
+
+/**
+ * Compresses the input using a single strategy
+ */
+static lz_error lzkn1_run_strategy(lzkn1_ctx *ctx, lzkn1_strategy strategy, lzkn1_matcher *matcher, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize, lzkn1_cancel *cancel) {
+
+	lzkn1_parser parser = { .tokens = ctx->tokens, .numTokens = 0, .rawQueueSize = 0 };
+
+	lz_error result = (strategy == LZKN1_STRATEGY_OPTIMAL)
+		? lzkn1_parse_optimal(ctx, matcher, &parser, cancel)
+		: lzkn1_parse_heuristic(strategy, matcher, &parser, cancel);
+
+	if (result == 0) {
+		result = lzkn1_emit(matcher->inBuff, matcher->inBuffSize, parser.tokens, parser.numTokens, outBuff, outBuffSize, compressedSize);
+	}
+
+	return result;
+}
+
+/**
+ * Creates a compressor/decompressor context
+ * 
+ * Returns NULL if allocation fails
+ */
+lzkn1_ctx * lzkn1_create_ctx(void) {
+
+	lzkn1_ctx * ctx = malloc(sizeof(lzkn1_ctx));
+
+	if (ctx) {
+		ctx->cost = NULL;
+		ctx->choice = NULL;
+		for (int i = 0; i < LZKN1_STRATEGY_COUNT - 1; ++i) {
+			ctx->workers[i] = NULL;
+		}
+		lzkn1_reset_ctx(ctx);
+	}
+
+	return ctx;
+}
+
+/**
+ * Resets context to its initial state, keeping allocated memory
+ */
+void lzkn1_reset_ctx(lzkn1_ctx *ctx) {
+
+	ctx->base = 0;
+
+	for (int32_t i = 0; i < 0x10000; ++i) {
+		ctx->head[i] = -1;
+	}
+}
+
+/**
+ * Destroys context and frees its working memory
+ */
+void lzkn1_destroy_ctx(lzkn1_ctx *ctx) {
+
+	if (ctx) {
+		for (int i = 0; i < LZKN1_STRATEGY_COUNT - 1; ++i) {
+			lzkn1_destroy_ctx(ctx->workers[i]);
+		}
+		free(ctx->cost);
+		free(ctx->choice);
+		free(ctx);
+	}
+}
+
+/**
+ * Compression function using a context and the given parse strategy
+ */
+lz_error lzkn1_compress_ctx(lzkn1_ctx *ctx, lzkn1_strategy strategy, const uint8_t *inBuff, const size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize) {
+
+	if ((unsigned)strategy >= LZKN1_STRATEGY_COUNT) {
+		return LZ_INVALID_ARGUMENT;
+	}
+	if (inBuffSize > 0xFFFF) {
+		return LZ_INBUFF_OVERFLOW;
+	}
+
+	lzkn1_matcher matcher;
+	lzkn1_matcher_init(&matcher, ctx, inBuff, inBuffSize, 0);
+
+	return lzkn1_run_strategy(ctx, strategy, &matcher, outBuff, outBuffSize, compressedSize, NULL);
+}
+
+/**
+ * Decoding loop shared by "lzkn1_decompress_ctx" and "lzkn1_verify"
+ * 
+ * Checks every access against the input, the expected size and the already
+ * decoded data, and writes the output to the given sink. Copies never reach
+ * further back than 1023 bytes, so a 1 KB ring sink is enough to decode.
+ */
+static lz_error lzkn1_decode(const uint8_t *inBuff, size_t inBuffSize, size_t outBuffSize, lzkn1_sink *sink, size_t *decompressedSize) {
+
+	uint8_t * const buff = sink->buff;
+	const size_t mask = sink->mask;
+	size_t inBuffPos = 0;
+	size_t outBuffPos = 0;
+
+	#define READ_BYTE(dest)	\
+		if (inBuffPos >= inBuffSize) { \
+			return LZ_INBUFF_OVERFLOW; \
+		} \
+		dest = inBuff[inBuffPos++];
+
+	#define EMIT_BYTE(value) { \
+			const uint8_t emitted = (value); \
+			buff[outBuffPos++ & mask] = emitted; \
+			if (sink->checksummed) { \
+				sink->adlerA += emitted; \
+				sink->adlerB += sink->adlerA; \
+				if (++sink->adlerPending == ADLER_NMAX) { \
+					sink->adlerA %= ADLER_MOD; \
+					sink->adlerB %= ADLER_MOD; \
+					sink->adlerPending = 0; \
+				} \
+			} \
+		}
+
+	uint8_t sizeHigh, sizeLow;
+	READ_BYTE(sizeHigh);
+	READ_BYTE(sizeLow);
+
+	const size_t expectedSize = (sizeHigh << 8) | sizeLow;
+
+	if (expectedSize > outBuffSize) {
+		return LZ_OUTBUFF_OVERFLOW;
+	}
+
+	uint8_t descField = 0;
+	int8_t descFieldRemainingBits = 0;
+
+	for (;;) {
+		if (!descFieldRemainingBits--) {
+			READ_BYTE(descField);
+			descFieldRemainingBits = 7;
+		}
+
+		uint8_t bit = descField & 1;
+		descField = descField >> 1;
+
+		uint8_t flag;
+		READ_BYTE(flag);
+
+		if (bit == BYTE_RAW) {
+			if (outBuffPos >= expectedSize) {
+				return LZ_OUTBUFF_OVERFLOW;
+			}
+			EMIT_BYTE(flag);
+		}
+		else if (flag == 0x1F) {
+			break;
+		}
+		else if (flag >= FLAG_COPY_RAW) {
+			const size_t copySize = flag - FLAG_COPY_RAW + 8;
+
+			if (inBuffPos + copySize > inBuffSize) {
+				return LZ_INBUFF_OVERFLOW;
+			}
+			if (outBuffPos + copySize > expectedSize) {
+				return LZ_OUTBUFF_OVERFLOW;
+			}
+
+			for (size_t i = 0; i < copySize; ++i) {
+				EMIT_BYTE(inBuff[inBuffPos++]);
+			}
+		}
+		else {
+			size_t copyDisp, copySize;
+
+			if (flag >= FLAG_COPY_MODE2) {
+				copyDisp = flag & 0xF;
+				copySize = (flag >> 4) - 6;
+			}
+			else {
+				uint8_t dispLow;
+				READ_BYTE(dispLow);
+
+				copyDisp = dispLow | ((flag << 3) & 0x300);
+				copySize = (flag & 0x1F) + 3;
+			}
+
+			if ((copyDisp == 0) || (copyDisp > outBuffPos)) {
+				return LZ_WINDOW_UNDERFLOW;
+			}
+			if (outBuffPos + copySize > expectedSize) {
+				return LZ_OUTBUFF_OVERFLOW;
+			}
+
+			for (size_t i = 0; i < copySize; ++i) {
+				EMIT_BYTE(buff[(outBuffPos - copyDisp) & mask]);
+			}
+		}
+	}
+
+	#undef READ_BYTE
+	#undef EMIT_BYTE
+
+	*decompressedSize = outBuffPos;
+
+	if (outBuffPos < expectedSize) {
+		return LZ_OUTBUFF_UNDERFLOW;
+	}
+	if (inBuffPos < inBuffSize) {
+		return LZ_INBUFF_UNDERFLOW;
+	}
+
+	return 0;
+}
+
+/**
+ * Decompression function using a context
+ * 
+ * Unlike "lzkn1_decompress", decompresses to the caller's buffer and checks every
+ * access against the input, the output and the already decompressed data.
+ * The context is reserved for future use and may be NULL.
+ */
+lz_error lzkn1_decompress_ctx(lzkn1_ctx *ctx, const uint8_t *inBuff, size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *decompressedSize) {
+
+	(void)ctx;		// no working memory is required at the moment
+
+	lzkn1_sink sink = { outBuff, SIZE_MAX, 0, 1, 0, 0 };
+
+	return lzkn1_decode(inBuff, inBuffSize, outBuffSize, &sink, decompressedSize);
+}
+
+/**
+ * Adler-32 checksum of the given buffer (same as zlib's "adler32")
+ */
+uint32_t lzkn1_checksum(const uint8_t *buff, size_t size) {
+
+	uint32_t a = 1, b = 0;
+
+	while (size > 0) {
+		size_t blockSize = (size < ADLER_NMAX) ? size : ADLER_NMAX;
+		size -= blockSize;
+
+		while (blockSize--) {
+			a += *buff++;
+			b += a;
+		}
+
+		a %= ADLER_MOD;
+		b %= ADLER_MOD;
+	}
+
+	return (b << 16) | a;
+}
+
+/**
+ * Decode-only verification function
+ * 
+ * Runs the same decoding loop as "lzkn1_decompress_ctx" and returns the same error
+ * codes, but keeps only the last 1 KB of output in a ring and checksums the output
+ * on the fly instead of storing it. If "expectedChecksum" is given, a valid stream
+ * with a different checksum yields LZ_CHECKSUM_MISMATCH.
+ */
+lz_error lzkn1_verify(const uint8_t *inBuff, size_t inBuffSize, const uint32_t *expectedChecksum, size_t *decompressedSize, uint32_t *checksum) {
+
+	uint8_t ring[VERIFY_RING];
+	lzkn1_sink sink = { ring, VERIFY_RING - 1, 1, 1, 0, 0 };
+
+	lz_error result = lzkn1_decode(inBuff, inBuffSize, SIZE_MAX, &sink, decompressedSize);
+
+	if (result) {
+		return result;
+	}
+
+	const uint32_t sum = ((sink.adlerB % ADLER_MOD) << 16) | (sink.adlerA % ADLER_MOD);
+
+	if (checksum) {
+		*checksum = sum;
+	}
+	if (expectedChecksum && (*expectedChecksum != sum)) {
+		return LZ_CHECKSUM_MISMATCH;
+	}
+
+	return 0;
+}
+
+/**
+ * Compression function using the given parse strategy
+ */
+lz_error lzkn1_compress_strategy(lzkn1_strategy strategy, const uint8_t *inBuff, const size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize) {
+
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+	if (!ctx) {
+		return LZ_ALLOC_FAILED;
+	}
+
+	lz_error result = lzkn1_compress_ctx(ctx, strategy, inBuff, inBuffSize, outBuff, outBuffSize, compressedSize);
+
+	lzkn1_destroy_ctx(ctx);
+
+	return result;
+}
+
+/**
+ * Portfolio job: compresses with the job's strategy and checks the result round-trips
+ */
+static void * lzkn1_job_run(void *arg) {
+
+	lzkn1_job * job = arg;
+
+	job->result = lzkn1_run_strategy(job->ctx, job->strategy, &job->matcher, job->outBuff, job->outBuffSize, &job->compressedSize, job->cancel);
+
+	if (job->result == 0) {
+		uint8_t * decompressedData = malloc(job->inBuffSize ? job->inBuffSize : 1);
+		size_t decompressedSize;
+
+		job->result = decompressedData
+			? lzkn1_decompress_ctx(job->ctx, job->outBuff, job->compressedSize, decompressedData, job->inBuffSize, &decompressedSize)
+			: LZ_ALLOC_FAILED;
+
+		if ((job->result == 0) && ((decompressedSize != job->inBuffSize) || (memcmp(decompressedData, job->inBuff, decompressedSize) != 0))) {
+			job->result = LZ_ROUNDTRIP_MISMATCH;
+		}
+
+		free(decompressedData);
+	}
+
+	// Nothing can beat the optimal parse, so stop the remaining jobs
+	if ((job->result == 0) && (job->strategy == LZKN1_STRATEGY_OPTIMAL)) {
+		lzkn1_set_cancelled(job->cancel);
+	}
+
+	return NULL;
+}
+
+/**
+ * Portfolio ("max") compression function
+ * 
+ * Runs all parse strategies in parallel, keeps the smallest result which round-trips
+ * and reports the winning strategy. The output doesn't depend on thread timing: the
+ * optimal result is kept whenever it round-trips.
+ */
+lz_error lzkn1_compress_max(const uint8_t *inBuff, const size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize, lzkn1_strategy *bestStrategy) {
+
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+	if (!ctx) {
+		return LZ_ALLOC_FAILED;
+	}
+
+	lz_error result = lzkn1_compress_max_ctx(ctx, inBuff, inBuffSize, outBuff, outBuffSize, compressedSize, bestStrategy);
+
+	lzkn1_destroy_ctx(ctx);
+
+	return result;
+}
+
+/**
+ * Portfolio ("max") compression function using a context
+ * 
+ * The first job works in the context itself, the others in worker contexts owned
+ * by it, so they're allocated only once per context.
+ */
+lz_error lzkn1_compress_max_ctx(lzkn1_ctx *ctx, const uint8_t *inBuff, const size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize, lzkn1_strategy *bestStrategy) {
+
+	if (inBuffSize > 0xFFFF) {
+		return LZ_INBUFF_OVERFLOW;
+	}
+
+	lz_error result = 0;
+	lzkn1_job jobs[LZKN1_STRATEGY_COUNT];
+	lzkn1_ctx * ctxs[LZKN1_STRATEGY_COUNT] = { ctx };
+	pthread_t threads[LZKN1_STRATEGY_COUNT];
+	int threadStarted[LZKN1_STRATEGY_COUNT] = { 0 };
+	lzkn1_cancel cancel = { .cancelled = 0 };
+
+	// Each job works in its own context, as contexts aren't shared between threads
+	for (int i = 1; i < LZKN1_STRATEGY_COUNT; ++i) {
+		if (!ctx->workers[i - 1]) {
+			ctx->workers[i - 1] = lzkn1_create_ctx();
+		}
+		if (!(ctxs[i] = ctx->workers[i - 1])) {
+			return LZ_ALLOC_FAILED;
+		}
+	}
+
+	const size_t jobBuffSize = LZKN1_COMPRESS_BOUND(inBuffSize);
+	uint8_t * jobBuffs = malloc(jobBuffSize * LZKN1_STRATEGY_COUNT);
+
+	if (!jobBuffs) {
+		return LZ_ALLOC_FAILED;
+	}
+
+	// Matches are shared by all strategies, so find them only once
+	lzkn1_matcher matcher;
+	lzkn1_matcher_init(&matcher, ctxs[0], inBuff, inBuffSize, 0);
+	lzkn1_find_matches(&matcher, NULL);
+
+	pthread_mutex_init(&cancel.mutex, NULL);
+
+	for (int i = 0; i < LZKN1_STRATEGY_COUNT; ++i) {
+		lzkn1_job * job = &jobs[i];
+
+		job->strategy = i;
+		job->ctx = ctxs[i];
+		job->inBuff = inBuff;
+		job->inBuffSize = inBuffSize;
+		job->matcher = matcher;
+		job->cancel = &cancel;
+		job->outBuff = jobBuffs + jobBuffSize * i;
+		job->outBuffSize = jobBuffSize;
+		job->compressedSize = 0;
+		job->result = 0;
+
+		threadStarted[i] = (pthread_create(&threads[i], NULL, lzkn1_job_run, job) == 0);
+	}
+
+	// Run jobs which couldn't get a thread on the calling one
+	for (int i = 0; i < LZKN1_STRATEGY_COUNT; ++i) {
+		if (threadStarted[i]) {
+			pthread_join(threads[i], NULL);
+		}
+		else {
+			lzkn1_job_run(&jobs[i]);
+		}
+	}
+
+	pthread_mutex_destroy(&cancel.mutex);
+
+	// A successful optimal job is always the smallest, but it cancels the others at
+	// an arbitrary point, so it must win regardless of which of them finished with
+	// the same size. Otherwise, no job was cancelled and the smallest valid result
+	// is picked (lowest strategy index wins ties).
+	const lzkn1_job * bestJob = NULL;
+
+	if (jobs[LZKN1_STRATEGY_OPTIMAL].result == 0) {
+		bestJob = &jobs[LZKN1_STRATEGY_OPTIMAL];
+	}
+	else {
+		for (int i = 0; i < LZKN1_STRATEGY_COUNT; ++i) {
+			if ((jobs[i].result == 0) && ((bestJob == NULL) || (jobs[i].compressedSize < bestJob->compressedSize))) {
+				bestJob = &jobs[i];
+			}
+		}
+	}
+
+	if (bestJob == NULL) {
+		result = jobs[LZKN1_STRATEGY_GREEDY].result;
+	}
+	else if (bestJob->compressedSize > outBuffSize) {
+		result = LZ_OUTBUFF_OVERFLOW;
+	}
+	else {
+		memcpy(outBuff, bestJob->outBuff, bestJob->compressedSize);
+		*compressedSize = bestJob->compressedSize;
+
+		if (bestStrategy) {
+			*bestStrategy = bestJob->strategy;
+		}
+	}
+
+	free(jobBuffs);
+
+	return result;
+}
+
+/**
+ * Time-bounded ("anytime") compression function
+ * 
+ * Produces a quick greedy result over shallow match search first, regardless of the
+ * budget. Then, until the time budget (in milliseconds) runs out, repeats the search
+ * in full and tries all strategies, cheapest first. The smallest stream found so far
+ * is returned, along with the strategy which produced it.
+ */
+lz_error lzkn1_compress_timed(lzkn1_ctx *ctx, const uint8_t *inBuff, const size_t inBuffSize, uint8_t *outBuff, size_t outBuffSize, size_t *compressedSize, uint32_t timeBudgetMs, lzkn1_strategy *bestStrategy) {
+
+	// Strategies in the order of increasing cost
+	static const lzkn1_strategy strategyQueue[] = {
+		LZKN1_STRATEGY_GREEDY, LZKN1_STRATEGY_MODE2, LZKN1_STRATEGY_LAZY, LZKN1_STRATEGY_RAW, LZKN1_STRATEGY_OPTIMAL
+	};
+
+	if (inBuffSize > 0xFFFF) {
+		return LZ_INBUFF_OVERFLOW;
+	}
+
+	lzkn1_cancel deadline = { .cancelled = 0, .hasDeadline = 1 };
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline.deadline);
+	deadline.deadline.tv_sec += timeBudgetMs / 1000;
+	deadline.deadline.tv_nsec += (long)(timeBudgetMs % 1000) * 1000000L;
+
+	if (deadline.deadline.tv_nsec >= 1000000000L) {
+		deadline.deadline.tv_sec += 1;
+		deadline.deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_init(&deadline.mutex, NULL);
+
+	// The quick pass always runs to completion, so there's a valid result to return
+	lzkn1_matcher matcher;
+	lzkn1_matcher_init(&matcher, ctx, inBuff, inBuffSize, QUICK_CHAIN_DEPTH);
+
+	lz_error result = lzkn1_run_strategy(ctx, LZKN1_STRATEGY_GREEDY, &matcher, outBuff, outBuffSize, compressedSize, NULL);
+
+	if ((result == 0) && bestStrategy) {
+		*bestStrategy = LZKN1_STRATEGY_GREEDY;
+	}
+
+	// Then repeat match search in full and improve the result while time permits
+	lzkn1_matcher_init(&matcher, ctx, inBuff, inBuffSize, 0);
+
+	if ((result == 0) && (lzkn1_find_matches(&matcher, &deadline) == 0)) {
+		for (size_t i = 0; (i < sizeof(strategyQueue) / sizeof(strategyQueue[0])) && !lzkn1_is_cancelled(&deadline); ++i) {
+			size_t candidateSize;
+
+			lz_error candidateResult = lzkn1_run_strategy(ctx, strategyQueue[i], &matcher, ctx->scratch, sizeof(ctx->scratch), &candidateSize, &deadline);
+
+			if ((candidateResult == 0) && (candidateSize < *compressedSize) && (candidateSize <= outBuffSize)) {
+				memcpy(outBuff, ctx->scratch, candidateSize);
+				*compressedSize = candidateSize;
+
+				if (bestStrategy) {
+					*bestStrategy = strategyQueue[i];
+				}
+			}
+		}
+	}
+
+	pthread_mutex_destroy(&deadline.mutex);
+
+	return result;
+}
+
+/**
+ * Number of online CPUs, used as the default number of threads (1 if unknown)
+ */
+int lzkn1_cpu_count(void) {
+
+#ifdef _SC_NPROCESSORS_ONLN
+	const long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (numCpus > 1) ? (int)numCpus : 1;
+#else
+	return 1;
+#endif
+}
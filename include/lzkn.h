@@ -18,6 +18,27 @@ typedef uint32_t lz_error;
 #define LZ_INBUFF_UNDERFLOW			0x4
 #define LZ_OUTBUFF_OVERFLOW			0x8
 #define LZ_OUTBUFF_UNDERFLOW		0x10
+#define LZ_CANCELLED				0x20
+#define LZ_WINDOW_UNDERFLOW			0x40
+#define LZ_CHECKSUM_MISMATCH		0x80
+#define LZ_ROUNDTRIP_MISMATCH		0x100
+#define LZ_INVALID_ARGUMENT			0x200
+
+// Worst-case compressed size (header and stop flag included) for the given uncompressed size
+#define LZKN1_COMPRESS_BOUND(size)	((size) + ((size) >> 3) + 4)
+
+// Parse strategies available to the compressor
+typedef enum {
+	LZKN1_STRATEGY_GREEDY = 0,		// longest match first (same decisions as "lzkn1_compress")
+	LZKN1_STRATEGY_LAZY,			// defers a match if the next position offers a better one
+	LZKN1_STRATEGY_OPTIMAL,			// shortest possible stream (dynamic programming)
+	LZKN1_STRATEGY_MODE2,			// prefers Mode 2 copies whenever they save as much as Mode 1
+	LZKN1_STRATEGY_RAW,				// prefers extending raw runs over short copies
+	LZKN1_STRATEGY_COUNT
+} lzkn1_strategy;
+
+// Compressor/decompressor context, owns all working memory (use one per thread)
+typedef struct lzkn1_ctx lzkn1_ctx;
 
 lz_error lzkn1_compress(
 	const uint8_t *inBuff, 
@@ -33,3 +54,82 @@ lz_error lzkn1_decompress(
 	uint8_t **outBuffPtr, 
 	size_t *decompressedSize
 );
+
+const char * lzkn1_strategy_name(lzkn1_strategy strategy);
+
+lz_error lzkn1_compress_strategy(
+	lzkn1_strategy strategy,
+	const uint8_t *inBuff, 
+	const size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *compressedSize
+);
+
+lz_error lzkn1_compress_max(
+	const uint8_t *inBuff, 
+	const size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *compressedSize,
+	lzkn1_strategy *bestStrategy
+);
+
+lzkn1_ctx * lzkn1_create_ctx(void);
+
+void lzkn1_reset_ctx(lzkn1_ctx *ctx);
+
+void lzkn1_destroy_ctx(lzkn1_ctx *ctx);
+
+lz_error lzkn1_compress_ctx(
+	lzkn1_ctx *ctx,
+	lzkn1_strategy strategy,
+	const uint8_t *inBuff, 
+	const size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *compressedSize
+);
+
+// Decompression needs no working memory, so "ctx" is reserved for future use and may be NULL
+lz_error lzkn1_decompress_ctx(
+	lzkn1_ctx *ctx,
+	const uint8_t *inBuff, 
+	size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *decompressedSize
+);
+
+lz_error lzkn1_compress_max_ctx(
+	lzkn1_ctx *ctx,
+	const uint8_t *inBuff, 
+	const size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *compressedSize,
+	lzkn1_strategy *bestStrategy
+);
+
+lz_error lzkn1_compress_timed(
+	lzkn1_ctx *ctx,
+	const uint8_t *inBuff, 
+	const size_t inBuffSize, 
+	uint8_t *outBuff, 
+	size_t outBuffSize, 
+	size_t *compressedSize,
+	uint32_t timeBudgetMs,
+	lzkn1_strategy *bestStrategy
+);
+
+uint32_t lzkn1_checksum(const uint8_t *buff, size_t size);
+
+lz_error lzkn1_verify(
+	const uint8_t *inBuff, 
+	size_t inBuffSize, 
+	const uint32_t *expectedChecksum,		// NULL to skip the comparison
+	size_t *decompressedSize,
+	uint32_t *checksum
+);
+
+int lzkn1_cpu_count(void);
@@ -0,0 +1,336 @@
+
+; ===============================================================
+; NOTICE
+; ===============================================================
+; Throughput-optimized variant of the LZKN1 decompressor (see the
+; "decompress.asm" for the original one).
+;
+; It's a drop-in replacement for KonDec, which trades code size
+; (about 500 bytes) for speed:
+; - description field bits are handled by unrolled code, so raw
+;   bytes no longer pay for DBF and JMP (a0) on every byte;
+; - description fields without flags copy 8 bytes at once;
+; - copies jump into unrolled MOVE.B sequences instead of looping
+;   with DBF;
+; - long compressed stream copies ($C8..$FF) move longwords once
+;   input and output are aligned alike.
+;
+; It uses the same registers as KonDec; a1, which serves as copy
+; source, is saved on the stack (4 bytes) for the call.
+;
+; The code syntax targets the ASM68K assembler.
+; Modify for the assembler of your choice if neccessary.
+; ===============================================================
+
+
+; ---------------------------------------------------------------
+; Konami's LZSS variant 1 (LZKN1) decompressor, fast version
+; ---------------------------------------------------------------
+; INPUT:
+;       a5      Input buffer (compressed data location)
+;       a6      Output buffer (decompressed data location)
+;
+; USES:
+;       d0-d2, a0, a5-a6 (same as KonDec)
+; ---------------------------------------------------------------
+
+KonDecFast:
+        move.l  a1,-(sp)        ; a1 is used as copy source, but KonDec preserves it
+        addq.l  #2,a5           ; skip data size in compressed stream
+        bra.s   @NextField
+; ---------------------------------------------------------------
+
+@AllRawBytes:
+        move.b  (a5)+,(a6)+     ; description field is zero,
+        move.b  (a5)+,(a6)+     ; so copy 8 raw bytes at once
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+
+@NextField:
+        move.b  (a5)+,d1        ; fetch a new decription field from compressed stream
+        beq.s   @AllRawBytes    ; if there are no flags, branch
+
+; ---------------------------------------------------------------
+; Unrolled description field handling: if bit=1, treat current
+; byte as decompression flag, otherwise copy it as raw data
+; ---------------------------------------------------------------
+
+@Bit0:
+        lsr.b   #1,d1
+        bcs.s   @Flag0
+        move.b  (a5)+,(a6)+
+
+@Bit1:
+        lsr.b   #1,d1
+        bcs.s   @Flag1
+        move.b  (a5)+,(a6)+
+
+@Bit2:
+        lsr.b   #1,d1
+        bcs.s   @Flag2
+        move.b  (a5)+,(a6)+
+
+@Bit3:
+        lsr.b   #1,d1
+        bcs.s   @Flag3
+        move.b  (a5)+,(a6)+
+
+@Bit4:
+        lsr.b   #1,d1
+        bcs.s   @Flag4
+        move.b  (a5)+,(a6)+
+
+@Bit5:
+        lsr.b   #1,d1
+        bcs.s   @Flag5
+        move.b  (a5)+,(a6)+
+
+@Bit6:
+        lsr.b   #1,d1
+        bcs.s   @Flag6
+        move.b  (a5)+,(a6)+
+
+@Bit7:
+        lsr.b   #1,d1
+        bcs.s   @Flag7
+        move.b  (a5)+,(a6)+
+        bra.s   @NextField
+; ---------------------------------------------------------------
+
+@Flag0: lea     @Bit1(pc),a0    ; a0 = where to continue after the flag
+        bra.s   @DecodeFlag
+
+@Flag1: lea     @Bit2(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag2: lea     @Bit3(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag3: lea     @Bit4(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag4: lea     @Bit5(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag5: lea     @Bit6(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag6: lea     @Bit7(pc),a0
+        bra.s   @DecodeFlag
+
+@Flag7: lea     @NextField(pc),a0
+; ---------------------------------------------------------------
+
+@DecodeFlag:
+        moveq   #0,d0
+        move.b  (a5)+,d0        ; read flag from a compressed stream
+        bpl.s   @Mode01         ; if bit 7 is clear, branch
+        cmpi.b  #$C0,d0
+        bhs.s   @CompCopyMode   ; if bits 7 and 6 are set, branch
+
+        ; Mode 2: %10nndddd
+        moveq   #$F,d2
+        and.w   d0,d2           ; d2 = Displacement (0..15)
+        movea.l a6,a1
+        suba.w  d2,a1           ; a1 = Source
+        lsr.b   #3,d0           ; d0 = %00010nnd
+        andi.w  #6,d0           ; d0 = %00000nn0
+        neg.w   d0
+        jmp     @UncCopyEnd-4(pc,d0.w)  ; copy 2..5 bytes
+; ---------------------------------------------------------------
+
+@Mode01:
+        ; Mode 1: %0ddnnnnn dddddddd
+        moveq   #$1F,d2
+        cmp.b   d2,d0
+        beq.s   @QuitDecomp     ; if flag is $1F, branch
+        and.w   d0,d2           ; d2 = %00000000 000nnnnn
+        lsl.w   #3,d0           ; d0 = %000000dd nnnnn000
+        move.b  (a5)+,d0        ; d0 = Displacement (0..1023)
+        movea.l a6,a1
+        suba.w  d0,a1           ; a1 = Source
+        add.w   d2,d2
+        neg.w   d2
+        jmp     @UncCopyEnd-6(pc,d2.w)  ; copy 3..34 bytes
+
+@UncCopy34:
+        move.b  (a1)+,(a6)+     ; self-copy block of uncompressed stream
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+        move.b  (a1)+,(a6)+
+
+@UncCopyEnd:
+        jmp     (a0)            ; back to description field handling
+; ---------------------------------------------------------------
+
+@QuitDecomp:
+        movea.l (sp)+,a1
+        rts
+; ---------------------------------------------------------------
+
+@CompCopyMode:
+        ; Compressed stream copy: %11nnnnnn
+        cmpi.b  #$C8,d0
+        blo.s   @CompCopyBytes  ; if less than 16 bytes, copy bytewise
+        move.w  a5,d2
+        sub.w   a6,d2
+        lsr.w   #1,d2
+        bcs.s   @CompCopyBytes  ; if input and output can't be aligned alike, branch
+        subi.w  #$B8,d0         ; d0 = Number of bytes to copy (16..71)
+        move.w  a5,d2
+        lsr.w   #1,d2
+        bcc.s   @CompCopyAligned        ; if input is already aligned, branch
+        move.b  (a5)+,(a6)+     ; copy one byte to align input and output
+        subq.w  #1,d0
+
+@CompCopyAligned:
+        moveq   #3,d2
+        and.w   d0,d2           ; d2 = Trailing bytes (0..3)
+        lsr.w   #2,d0           ; d0 = Number of longwords (3..17)
+        add.w   d0,d0
+        neg.w   d0
+        jmp     @CompCopyLongsEnd(pc,d0.w)
+
+        move.l  (a5)+,(a6)+     ; copy uncompressed longwords
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+        move.l  (a5)+,(a6)+
+
+@CompCopyLongsEnd:
+        add.w   d2,d2
+        neg.w   d2
+        jmp     @CompCopyTailEnd(pc,d2.w)
+
+        move.b  (a5)+,(a6)+     ; copy trailing bytes
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+
+@CompCopyTailEnd:
+        jmp     (a0)            ; back to description field handling
+; ---------------------------------------------------------------
+
+@CompCopyBytes:
+        not.b   d0              ; d0 = 71 - Number of bytes to copy
+        add.w   d0,d0
+        jmp     @CompCopy71(pc,d0.w)
+
+@CompCopy71:
+        move.b  (a5)+,(a6)+     ; copy uncompressed bytes
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        move.b  (a5)+,(a6)+
+        jmp     (a0)            ; back to description field handling
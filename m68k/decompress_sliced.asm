@@ -0,0 +1,194 @@
+
+; ===============================================================
+; NOTICE
+; ===============================================================
+; Time-sliced variant of the LZKN1 decompressor (see the
+; "decompress.asm" for the original one).
+;
+; Decompression is split into slices of a given number of output
+; bytes. After each slice the decoder saves its state to a small
+; RAM structure and returns, so large assets can be streamed
+; across several frames (e.g. during VBlank intervals) instead of
+; stalling the game until the whole asset is decompressed.
+;
+; The code syntax targets the ASM68K assembler.
+; Modify for the assembler of your choice if neccessary.
+; ===============================================================
+
+
+; ---------------------------------------------------------------
+; Decompressor state structure
+; ---------------------------------------------------------------
+
+KonDecSliced_Src:       equ     0       ; .l    compressed stream pointer (a5)
+KonDecSliced_Dst:       equ     4       ; .l    output pointer (a6)
+KonDecSliced_Desc:      equ     8       ; .w    description field being shifted (d1)
+KonDecSliced_Bits:      equ     10      ; .w    bits left in description field (d7), -1 = finished
+KonDecSliced_CopyLen:   equ     12      ; .w    bytes left of the interrupted copy
+KonDecSliced_CopyDisp:  equ     14      ; .w    negated displacement of the copy, 0 = raw bytes
+                                        ;       (valid streams never use displacement 0)
+KonDecSliced_Size:      equ     16
+
+; ---------------------------------------------------------------
+; Initializes the decompressor state
+; ---------------------------------------------------------------
+; INPUT:
+;       a1      Decompressor state (KonDecSliced_Size bytes)
+;       a5      Input buffer (compressed data location)
+;       a6      Output buffer (decompressed data location)
+; ---------------------------------------------------------------
+
+KonDecSliced_Init:
+        addq.l  #2,a5           ; skip data size in compressed stream
+        move.l  a5,KonDecSliced_Src(a1)
+        move.l  a6,KonDecSliced_Dst(a1)
+        clr.w   KonDecSliced_Desc(a1)
+        clr.w   KonDecSliced_Bits(a1)   ; fetch a description field first
+        clr.l   KonDecSliced_CopyLen(a1); no copy in progress
+        rts
+
+; ---------------------------------------------------------------
+; Decompresses the next slice of data
+; ---------------------------------------------------------------
+; INPUT:
+;       a1      Decompressor state
+;       d0.w    Number of bytes to output in this slice (0..65535)
+;
+; OUTPUT:
+;       d0.l    0 if decompression is finished, -1 otherwise
+;
+; USES:
+;       d0-d2, d6-d7, a5-a6
+;
+; NOTICE: Exactly d0.w bytes are output unless the stream ends
+; earlier. If it ends exactly at the slice boundary, the end is
+; only discovered by the next call, which outputs nothing.
+; ---------------------------------------------------------------
+
+KonDecSliced_Resume:
+        move.w  KonDecSliced_Bits(a1),d7
+        bmi.w   @AlreadyFinished        ; if stream is finished, branch
+        move.w  d0,d6           ; d6 = output budget
+        beq.w   @NoBudget
+        movem.l KonDecSliced_Src(a1),a5-a6
+        move.w  KonDecSliced_Desc(a1),d1
+        move.w  KonDecSliced_CopyLen(a1),d2
+        beq.s   @MainLoop       ; if no copy was interrupted, branch
+        move.w  KonDecSliced_CopyDisp(a1),d0
+        bra.s   @Copy           ; finish the interrupted copy
+; ---------------------------------------------------------------
+
+@MainLoop:
+        dbf     d7,@RunDecoding ; if bits in decription field remain, branch
+        moveq   #7,d7           ; set repeat count to 8
+        move.b  (a5)+,d1        ; fetch a new decription field from compressed stream
+
+@RunDecoding:
+        lsr.w   #1,d1           ; shift a bit from the description bitfield
+        bcs.s   @DecodeFlag     ; if bit=1, treat current byte as decompression flag
+        move.b  (a5)+,(a6)+     ; if bit=0, treat current byte as raw data
+        subq.w  #1,d6           ; decrease output budget
+        bne.s   @MainLoop       ; if budget remains, branch
+        bra.s   @Suspend
+; ---------------------------------------------------------------
+
+@DecodeFlag:
+        moveq   #0,d0
+        move.b  (a5)+,d0        ; read flag from a compressed stream
+        bmi.s   @Mode10or11     ; if bit 7 is set, branch
+        cmpi.b  #$1F,d0
+        beq.w   @Finish         ; if flag is $1F, branch
+        move.w  d0,d2           ; d2 = %00000000 0ddnnnnn
+        lsl.w   #3,d0           ; d0 = %000000dd nnnnn000
+        move.b  (a5)+,d0        ; d0 = Displacement (0..1023)
+        andi.w  #$1F,d2         ; d2 = %00000000 000nnnnn
+        addq.w  #3,d2           ; d2 = Copy length (3..34)
+        neg.w   d0              ; negate displacement
+        bra.s   @Copy
+; ---------------------------------------------------------------
+
+@Mode10or11:
+        btst    #6,d0
+        bne.s   @RawRun         ; if bits 7 and 6 are set, branch
+        move.w  d0,d2           ; d2 = %00000000 10nndddd
+        lsr.w   #4,d2           ; d2 = %00000000 000010nn
+        subq.w  #6,d2           ; d2 = Copy length (2..5)
+        andi.w  #$F,d0          ; d0 = Displacement (0..15)
+        neg.w   d0              ; negate displacement
+        bra.s   @Copy
+; ---------------------------------------------------------------
+
+@RawRun:
+        move.w  d0,d2
+        subi.w  #$B8,d2         ; d2 = Copy length (8..71)
+        moveq   #0,d0           ; copy raw bytes from compressed stream
+
+; ---------------------------------------------------------------
+; Copies d2.w bytes (from the window if d0.w < 0, otherwise raw
+; bytes), stopping once the output budget is exhausted
+; ---------------------------------------------------------------
+
+@Copy:
+        cmp.w   d6,d2
+        bhi.s   @CopyPartial    ; if copy doesn't fit in the budget, branch
+        sub.w   d2,d6           ; decrease output budget
+        subq.w  #1,d2           ; d2 = Repeat count
+        tst.w   d0
+        beq.s   @RawCopyLoop    ; if copying raw bytes, branch
+
+@UncCopyLoop:
+        move.b  (a6,d0.w),(a6)+ ; self-copy block of uncompressed stream
+        dbf     d2,@UncCopyLoop ; repeat
+        tst.w   d6
+        bne.s   @MainLoop       ; if budget remains, branch
+        bra.s   @Suspend
+; ---------------------------------------------------------------
+
+@RawCopyLoop:
+        move.b  (a5)+,(a6)+     ; copy uncompressed byte
+        dbf     d2,@RawCopyLoop ; repeat
+        tst.w   d6
+        bne.s   @MainLoop       ; if budget remains, branch
+
+@Suspend:
+        clr.l   KonDecSliced_CopyLen(a1)        ; no copy in progress
+
+@SaveState:
+        movem.l a5-a6,KonDecSliced_Src(a1)
+        move.w  d1,KonDecSliced_Desc(a1)
+        move.w  d7,KonDecSliced_Bits(a1)
+
+@NoBudget:
+        moveq   #-1,d0          ; report decompression isn't finished
+        rts
+; ---------------------------------------------------------------
+
+@CopyPartial:
+        sub.w   d6,d2           ; d2 = Bytes left for the next slice
+        move.w  d2,KonDecSliced_CopyLen(a1)
+        move.w  d0,KonDecSliced_CopyDisp(a1)
+        subq.w  #1,d6           ; d6 = Repeat count (the rest of the budget)
+        tst.w   d0
+        beq.s   @RawPartialLoop ; if copying raw bytes, branch
+
+@UncPartialLoop:
+        move.b  (a6,d0.w),(a6)+ ; self-copy block of uncompressed stream
+        dbf     d6,@UncPartialLoop      ; repeat
+        bra.s   @SaveState
+; ---------------------------------------------------------------
+
+@RawPartialLoop:
+        move.b  (a5)+,(a6)+     ; copy uncompressed byte
+        dbf     d6,@RawPartialLoop      ; repeat
+        bra.s   @SaveState
+; ---------------------------------------------------------------
+
+@Finish:
+        movem.l a5-a6,KonDecSliced_Src(a1)
+        move.w  d1,KonDecSliced_Desc(a1)
+        move.w  #-1,KonDecSliced_Bits(a1)       ; mark stream as finished
+        clr.l   KonDecSliced_CopyLen(a1)        ; no copy in progress
+
+@AlreadyFinished:
+        moveq   #0,d0           ; report decompression is finished
+        rts
@@ -0,0 +1,127 @@
+
+/* ================================================================================= *
+ * Host-side reference model of the time-sliced M68K decompressor					 *
+ *																					 *
+ * Follows "KonDecSliced_Resume" step by step, so the state saved by the M68K		 *
+ * code can be compared with the model after every slice.							 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kondec_model.h"
+
+void konDecSlicedInit(konDecSlicedState * state) {
+	state->src = 2;			// skip data size in compressed stream
+	state->dst = 0;
+	state->desc = 0;
+	state->bits = 0;
+	state->copyLen = 0;
+	state->copyDisp = 0;
+}
+
+/*
+ * Decompresses the next slice of at most `budget` bytes
+ *
+ * Returns KONDEC_FINISHED, KONDEC_SUSPENDED or KONDEC_OVERFLOW if the stream
+ * reaches outside of the buffers.
+ */
+int konDecSlicedResume(konDecSlicedState * state, const uint8_t * in, size_t inSize, uint8_t * out, size_t outSize, uint16_t budget) {
+	#define READ_IN(dest) { if (state->src >= inSize) return KONDEC_OVERFLOW; dest = in[state->src++]; }
+	#define WRITE_OUT(value) { if (state->dst >= outSize) return KONDEC_OVERFLOW; out[state->dst++] = (value); }
+
+	if (state->bits < 0) {
+		return KONDEC_FINISHED;
+	}
+
+	if (budget == 0) {
+		return KONDEC_SUSPENDED;
+	}
+
+	uint16_t copyLen = state->copyLen;
+	int16_t copyDisp = state->copyDisp;
+
+	for (;;) {
+		if (copyLen == 0) {
+			// Fetch the next token
+			if (--state->bits < 0) {
+				state->bits = 7;
+				uint8_t field;
+				READ_IN(field);
+				state->desc = (state->desc & 0xFF00) | field;
+			}
+
+			const int isFlag = state->desc & 1;
+			state->desc >>= 1;
+
+			if (!isFlag) {
+				uint8_t value;
+				READ_IN(value);
+				WRITE_OUT(value);
+				if (--budget == 0) {
+					break;
+				}
+				continue;
+			}
+
+			uint8_t flag;
+			READ_IN(flag);
+
+			if (flag == 0x1F) {
+				state->bits = -1;
+				state->copyLen = 0;
+				state->copyDisp = 0;
+				return KONDEC_FINISHED;
+			}
+			else if (!(flag & 0x80)) {
+				uint8_t low;
+				READ_IN(low);
+				copyLen = (flag & 0x1F) + 3;
+				copyDisp = -(int16_t)((((flag << 3) & 0xFF00) | low));
+			}
+			else if (!(flag & 0x40)) {
+				copyLen = (flag >> 4) - 6;
+				copyDisp = -(int16_t)(flag & 0xF);
+			}
+			else {
+				copyLen = flag - 0xB8;
+				copyDisp = 0;
+			}
+		}
+
+		// Copy as much as the budget allows
+		const uint16_t count = (copyLen > budget) ? budget : copyLen;
+
+		for (uint16_t i = 0; i < count; ++i) {
+			if (copyDisp == 0) {
+				uint8_t value;
+				READ_IN(value);
+				WRITE_OUT(value);
+			}
+			else {
+				if ((uint32_t)-copyDisp > state->dst) {
+					return KONDEC_OVERFLOW;
+				}
+				const uint8_t value = out[state->dst + copyDisp];
+				WRITE_OUT(value);
+			}
+		}
+
+		copyLen -= count;
+		budget -= count;
+
+		if (budget == 0) {
+			break;
+		}
+	}
+
+	state->copyLen = copyLen;
+	state->copyDisp = copyLen ? copyDisp : 0;
+
+	return KONDEC_SUSPENDED;
+
+	#undef READ_IN
+	#undef WRITE_OUT
+}
@@ -0,0 +1,26 @@
+
+/* ================================================================================= *
+ * Host-side reference model of the time-sliced M68K decompressor					 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Mirrors the "KonDecSliced" state structure, pointers are buffer offsets */
+typedef struct {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t desc;
+	int16_t bits;				// -1 = finished
+	uint16_t copyLen;
+	int16_t copyDisp;			// negated displacement, 0 = raw bytes
+} konDecSlicedState;
+
+#define KONDEC_FINISHED		0
+#define KONDEC_SUSPENDED	-1
+#define KONDEC_OVERFLOW		1
+
+void konDecSlicedInit(konDecSlicedState * state);
+int konDecSlicedResume(konDecSlicedState * state, const uint8_t * in, size_t inSize, uint8_t * out, size_t outSize, uint16_t budget);
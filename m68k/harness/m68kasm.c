@@ -0,0 +1,1151 @@
+
+/* ================================================================================= *
+ * Minimal ASM68K-syntax assembler for testing the M68K decompressors				 *
+ *																					 *
+ * Supports the instruction subset implemented by the emulator, "@" local labels,	 *
+ * "equ"/"=" constants and "dc"/"ds"/"even" directives. Branches default to .w		 *
+ * and absolute addresses default to .l, so sizes never depend on symbol values		 *
+ * and two passes are always enough.												 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+
+#include "m68kasm.h"
+
+#define ASM_ADDRESS_MASK	0xFFFFFF
+#define ASM_MAX_LINE		512
+#define ASM_MAX_OPERANDS	8
+
+/* Operand kinds */
+#define OP_DREG			0
+#define OP_AREG			1
+#define OP_IND			2		// (An)
+#define OP_POSTINC		3		// (An)+
+#define OP_PREDEC		4		// -(An)
+#define OP_DISP			5		// d16(An)
+#define OP_INDEX		6		// d8(An,Xn)
+#define OP_ABS_W		7		// (xxx).w
+#define OP_ABS_L		8		// (xxx).l
+#define OP_PC_DISP		9		// d16(pc)
+#define OP_PC_INDEX		10		// d8(pc,Xn)
+#define OP_IMMEDIATE	11		// #xxx
+#define OP_REGLIST		12		// d0-d7/a0-a6
+
+typedef struct {
+	int kind;
+	int reg;
+	int32_t value;				// displacement, address or immediate
+	int indexReg;				// 0..15 (a0 = 8)
+	int indexLong;
+	uint16_t regMask;			// for OP_REGLIST
+} asmOperand;
+
+typedef struct {
+	asmProgram * program;
+	uint8_t * memory;
+	char scope[ASM_MAX_SYMBOL_LENGTH];		// last global label, for "@" locals
+	uint32_t pc;
+	int pass;
+	int line;
+	int failed;
+} asmState;
+
+
+/* ----------------------------------------------------------------------------- */
+/* Diagnostics and symbols														 */
+/* ----------------------------------------------------------------------------- */
+
+static void asmError(asmState * state, const char * format, ...) {
+	if (state->failed) {
+		return;
+	}
+
+	va_list args;
+	va_start(args, format);
+	int length = snprintf(state->program->error, sizeof(state->program->error), "line %d: ", state->line);
+	vsnprintf(state->program->error + length, sizeof(state->program->error) - length, format, args);
+	va_end(args);
+
+	state->failed = 1;
+}
+
+static void fullSymbolName(asmState * state, const char * name, char * fullName) {
+	if (name[0] == '@') {
+		snprintf(fullName, ASM_MAX_SYMBOL_LENGTH, "%.31s%.32s", state->scope, name);
+	}
+	else {
+		snprintf(fullName, ASM_MAX_SYMBOL_LENGTH, "%s", name);
+	}
+}
+
+static asmSymbol * findSymbol(asmProgram * program, const char * name) {
+	for (int i = 0; i < program->symbolCount; ++i) {
+		if (strcmp(program->symbols[i].name, name) == 0) {
+			return &program->symbols[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Finds a local label outside of the current scope
+ *
+ * The disassembled KonDec branches to "@InitDecomp" across the "KonDec2" label,
+ * so a local label that's unique in the file is accepted from any scope.
+ */
+static asmSymbol * findUniqueLocal(asmProgram * program, const char * name) {
+	asmSymbol * found = NULL;
+	const size_t length = strlen(name);
+
+	for (int i = 0; i < program->symbolCount; ++i) {
+		const char * symbolName = program->symbols[i].name;
+		const size_t symbolLength = strlen(symbolName);
+
+		if ((symbolLength > length) && (strcmp(symbolName + symbolLength - length, name) == 0)) {
+			if (found) {
+				return NULL;
+			}
+			found = &program->symbols[i];
+		}
+	}
+
+	return found;
+}
+
+/* Defines symbol, global labels open a new scope for "@" locals but constants don't */
+static void defineSymbol(asmState * state, const char * name, int32_t value, int opensScope) {
+	asmProgram * program = state->program;
+	char fullName[ASM_MAX_SYMBOL_LENGTH];
+
+	if (opensScope && (name[0] != '@')) {
+		snprintf(state->scope, sizeof(state->scope), "%s", name);
+	}
+
+	fullSymbolName(state, name, fullName);
+
+	asmSymbol * symbol = findSymbol(program, fullName);
+
+	if (symbol) {
+		if ((state->pass == 1) && (symbol->value != value)) {
+			asmError(state, "symbol '%s' redefined", fullName);
+		}
+		symbol->value = value;
+		return;
+	}
+
+	if (program->symbolCount == program->symbolCapacity) {
+		program->symbolCapacity = program->symbolCapacity ? program->symbolCapacity * 2 : 64;
+		program->symbols = realloc(program->symbols, program->symbolCapacity * sizeof(asmSymbol));
+	}
+
+	symbol = &program->symbols[program->symbolCount++];
+	snprintf(symbol->name, sizeof(symbol->name), "%s", fullName);
+	symbol->value = value;
+}
+
+
+/* ----------------------------------------------------------------------------- */
+/* Expressions																	 */
+/* ----------------------------------------------------------------------------- */
+
+static int isSymbolChar(char c, int first) {
+	return isalpha((unsigned char)c) || (c == '_') || (c == '@') || (c == '.' && !first) || (!first && isdigit((unsigned char)c)) || (c == '?');
+}
+
+static const char * skipSpaces(const char * s) {
+	while (*s == ' ' || *s == '\t') {
+		s++;
+	}
+	return s;
+}
+
+static int32_t parseExpression(asmState * state, const char ** s);
+
+static int32_t parsePrimary(asmState * state, const char ** s) {
+	const char * p = skipSpaces(*s);
+	int32_t value = 0;
+
+	if (*p == '(') {
+		p++;
+		value = parseExpression(state, &p);
+		p = skipSpaces(p);
+		if (*p != ')') {
+			asmError(state, "missing ')'");
+		}
+		else {
+			p++;
+		}
+	}
+	else if (*p == '-' || *p == '+' || *p == '~') {
+		const char op = *p++;
+		value = parsePrimary(state, &p);
+		value = (op == '-') ? -value : (op == '~') ? ~value : value;
+	}
+	else if (*p == '$') {
+		p++;
+		if (!isxdigit((unsigned char)*p)) {
+			asmError(state, "bad hexadecimal number");
+		}
+		while (isxdigit((unsigned char)*p)) {
+			value = value * 16 + (isdigit((unsigned char)*p) ? *p - '0' : (tolower((unsigned char)*p) - 'a' + 10));
+			p++;
+		}
+	}
+	else if (*p == '%') {
+		p++;
+		if (*p != '0' && *p != '1') {
+			asmError(state, "bad binary number");
+		}
+		while (*p == '0' || *p == '1') {
+			value = value * 2 + (*p++ - '0');
+		}
+	}
+	else if (isdigit((unsigned char)*p)) {
+		while (isdigit((unsigned char)*p)) {
+			value = value * 10 + (*p++ - '0');
+		}
+	}
+	else if (*p == '*') {
+		p++;
+		value = state->pc;
+	}
+	else if (isSymbolChar(*p, 1)) {
+		char name[ASM_MAX_SYMBOL_LENGTH];
+		char fullName[ASM_MAX_SYMBOL_LENGTH];
+		size_t length = 0;
+
+		while (isSymbolChar(*p, length == 0)) {
+			if (length < sizeof(name) - 1) {
+				name[length++] = *p;
+			}
+			p++;
+		}
+		name[length] = '\0';
+
+		// ".w"/".l" size suffixes belong to the operand, not to the symbol
+		if ((length > 2) && (name[length - 2] == '.') && strchr("wWlLbBsS", name[length - 1])) {
+			p -= 2;
+			name[length - 2] = '\0';
+		}
+
+		fullSymbolName(state, name, fullName);
+
+		asmSymbol * symbol = findSymbol(state->program, fullName);
+
+		if (!symbol && (name[0] == '@')) {
+			symbol = findUniqueLocal(state->program, name);
+		}
+
+		if (symbol) {
+			value = symbol->value;
+		}
+		else if (state->pass == 2) {
+			asmError(state, "undefined symbol '%s'", name);
+		}
+	}
+	else {
+		asmError(state, "bad expression");
+	}
+
+	*s = p;
+	return value;
+}
+
+static int32_t parseTerm(asmState * state, const char ** s) {
+	int32_t value = parsePrimary(state, s);
+
+	for (;;) {
+		const char * p = skipSpaces(*s);
+
+		if (*p == '*' || *p == '/') {
+			const char op = *p++;
+			const int32_t rhs = parsePrimary(state, &p);
+
+			if (op == '*') {
+				value *= rhs;
+			}
+			else if (rhs == 0) {
+				asmError(state, "division by zero");
+			}
+			else {
+				value /= rhs;
+			}
+			*s = p;
+		}
+		else if ((p[0] == '<' && p[1] == '<') || (p[0] == '>' && p[1] == '>')) {
+			const char op = *p;
+			p += 2;
+			const int32_t rhs = parsePrimary(state, &p);
+			value = (op == '<') ? (int32_t)((uint32_t)value << rhs) : (value >> rhs);
+			*s = p;
+		}
+		else {
+			return value;
+		}
+	}
+}
+
+static int32_t parseExpression(asmState * state, const char ** s) {
+	int32_t value = parseTerm(state, s);
+
+	for (;;) {
+		const char * p = skipSpaces(*s);
+
+		if (*p == '+' || *p == '-' || *p == '&' || *p == '|' || *p == '^') {
+			const char op = *p++;
+			const int32_t rhs = parseTerm(state, &p);
+
+			switch (op) {
+				case '+': value += rhs; break;
+				case '-': value -= rhs; break;
+				case '&': value &= rhs; break;
+				case '|': value |= rhs; break;
+				default: value ^= rhs; break;
+			}
+			*s = p;
+		}
+		else {
+			return value;
+		}
+	}
+}
+
+static int32_t evaluate(asmState * state, const char * text) {
+	const char * p = text;
+	const int32_t value = parseExpression(state, &p);
+
+	if (*skipSpaces(p) != '\0') {
+		asmError(state, "junk after expression: '%s'", p);
+	}
+
+	return value;
+}
+
+
+/* ----------------------------------------------------------------------------- */
+/* Operands																		 */
+/* ----------------------------------------------------------------------------- */
+
+/* Returns register number (d0..d7 = 0..7, a0..a7 = 8..15) or -1 */
+static int parseRegister(const char * text, size_t length) {
+	if ((length == 2) && (tolower((unsigned char)text[0]) == 's') && (tolower((unsigned char)text[1]) == 'p')) {
+		return 15;
+	}
+
+	if ((length != 2) || (text[1] < '0') || (text[1] > '7')) {
+		return -1;
+	}
+
+	switch (tolower((unsigned char)text[0])) {
+		case 'd': return text[1] - '0';
+		case 'a': return 8 + text[1] - '0';
+		default: return -1;
+	}
+}
+
+static int isPC(const char * text, size_t length) {
+	return (length == 2) && (strncasecmp(text, "pc", 2) == 0);
+}
+
+/* Parses register list such as "d0-d2/a5-a6" */
+static int parseRegisterList(const char * text, uint16_t * mask) {
+	*mask = 0;
+
+	while (*text) {
+		const char * end = text;
+		while (*end && *end != '/') {
+			end++;
+		}
+
+		const char * dash = memchr(text, '-', end - text);
+		const int first = parseRegister(text, dash ? (size_t)(dash - text) : (size_t)(end - text));
+		const int last = dash ? parseRegister(dash + 1, end - dash - 1) : first;
+
+		if ((first < 0) || (last < first)) {
+			return -1;
+		}
+
+		for (int r = first; r <= last; ++r) {
+			*mask |= 1 << r;
+		}
+
+		text = *end ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+/* Parses "Xn", "Xn.w" or "Xn.l" index register */
+static int parseIndex(asmState * state, const char * text, asmOperand * op) {
+	text = skipSpaces(text);
+	size_t length = strlen(text);
+
+	while (length && (text[length - 1] == ' ' || text[length - 1] == '\t')) {
+		length--;
+	}
+
+	op->indexLong = 0;
+
+	if ((length == 4) && (text[2] == '.')) {
+		const char suffix = tolower((unsigned char)text[3]);
+		if (suffix != 'w' && suffix != 'l') {
+			asmError(state, "bad index size");
+		}
+		op->indexLong = (suffix == 'l');
+		length = 2;
+	}
+
+	op->indexReg = parseRegister(text, length);
+
+	if (op->indexReg < 0) {
+		asmError(state, "bad index register");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void parseOperand(asmState * state, char * text, asmOperand * op) {
+	size_t length = strlen(text);
+	int reg;
+
+	memset(op, 0, sizeof(*op));
+
+	if (text[0] == '#') {
+		op->kind = OP_IMMEDIATE;
+		op->value = evaluate(state, text + 1);
+		return;
+	}
+
+	if ((reg = parseRegister(text, length)) >= 0) {
+		op->kind = (reg < 8) ? OP_DREG : OP_AREG;
+		op->reg = reg & 7;
+		op->regMask = 1 << reg;
+		return;
+	}
+
+	if ((strpbrk(text, "/-") != NULL) && (parseRegisterList(text, &op->regMask) == 0)) {
+		op->kind = OP_REGLIST;
+		return;
+	}
+
+	if ((text[0] == '(') && (length >= 5) && (text[length - 1] == '+') && (text[length - 2] == ')')
+			&& ((reg = parseRegister(text + 1, length - 3)) >= 8)) {
+		op->kind = OP_POSTINC;
+		op->reg = reg & 7;
+		return;
+	}
+
+	if ((text[0] == '-') && (text[1] == '(') && (text[length - 1] == ')')
+			&& ((reg = parseRegister(text + 2, length - 3)) >= 8)) {
+		op->kind = OP_PREDEC;
+		op->reg = reg & 7;
+		return;
+	}
+
+	// Absolute addressing with explicit size
+	if ((length > 2) && (text[length - 2] == '.') && strchr("wWlL", text[length - 1])) {
+		op->kind = (tolower((unsigned char)text[length - 1]) == 'w') ? OP_ABS_W : OP_ABS_L;
+		text[length - 2] = '\0';
+		op->value = evaluate(state, text);
+		return;
+	}
+
+	// "disp(An)", "disp(An,Xn)", "disp(pc)", "disp(pc,Xn)"
+	if (text[length - 1] == ')') {
+		int depth = 0;
+		size_t open = length - 1;
+
+		for (;; --open) {
+			if (text[open] == ')') {
+				depth++;
+			}
+			else if ((text[open] == '(') && (--depth == 0)) {
+				break;
+			}
+			if (open == 0) {
+				break;
+			}
+		}
+
+		char * inner = text + open + 1;
+		text[length - 1] = '\0';
+
+		char * comma = strchr(inner, ',');
+		const size_t baseLength = comma ? (size_t)(comma - inner) : strlen(inner);
+		const int pc = isPC(inner, baseLength);
+		reg = parseRegister(inner, baseLength);
+
+		if (pc || (reg >= 8)) {
+			text[open] = '\0';
+			op->value = *skipSpaces(text) ? evaluate(state, text) : 0;
+			op->reg = reg & 7;
+
+			if (comma) {
+				op->kind = pc ? OP_PC_INDEX : OP_INDEX;
+				parseIndex(state, comma + 1, op);
+			}
+			else if (pc) {
+				op->kind = OP_PC_DISP;
+			}
+			else {
+				op->kind = (open == 0) ? OP_IND : OP_DISP;
+			}
+			return;
+		}
+
+		text[length - 1] = ')';
+	}
+
+	op->kind = OP_ABS_L;
+	op->value = evaluate(state, text);
+}
+
+
+/* ----------------------------------------------------------------------------- */
+/* Code generation																 */
+/* ----------------------------------------------------------------------------- */
+
+static void emit(asmState * state, int size, uint32_t value) {
+	if (state->pass == 2) {
+		for (int i = size - 1; i >= 0; --i, value >>= 8) {
+			state->memory[(state->pc + i) & ASM_ADDRESS_MASK] = value;
+		}
+	}
+	state->pc += size;
+}
+
+static void emitWord(asmState * state, uint32_t value) {
+	emit(state, 2, value);
+}
+
+/* Returns 6-bit mode/register field of the effective address */
+static uint16_t eaField(asmState * state, const asmOperand * op) {
+	switch (op->kind) {
+		case OP_DREG: return op->reg;
+		case OP_AREG: return 0x08 | op->reg;
+		case OP_IND: return 0x10 | op->reg;
+		case OP_POSTINC: return 0x18 | op->reg;
+		case OP_PREDEC: return 0x20 | op->reg;
+		case OP_DISP: return 0x28 | op->reg;
+		case OP_INDEX: return 0x30 | op->reg;
+		case OP_ABS_W: return 0x38;
+		case OP_ABS_L: return 0x39;
+		case OP_PC_DISP: return 0x3A;
+		case OP_PC_INDEX: return 0x3B;
+		case OP_IMMEDIATE: return 0x3C;
+		default:
+			asmError(state, "register list isn't allowed here");
+			return 0;
+	}
+}
+
+static void checkRange(asmState * state, int32_t value, int32_t min, int32_t max, const char * what) {
+	if ((state->pass == 2) && ((value < min) || (value > max))) {
+		asmError(state, "%s out of range: %d", what, value);
+	}
+}
+
+/* Emits extension words of the effective address */
+static void eaExtension(asmState * state, const asmOperand * op, int size) {
+	switch (op->kind) {
+		case OP_DISP:
+			checkRange(state, op->value, -0x8000, 0x7FFF, "displacement");
+			emitWord(state, op->value);
+			break;
+		case OP_INDEX:
+			checkRange(state, op->value, -0x80, 0x7F, "displacement");
+			emitWord(state, (op->indexReg << 12) | (op->indexLong << 11) | (op->value & 0xFF));
+			break;
+		case OP_ABS_W:
+			checkRange(state, op->value, -0x8000, 0xFFFF, "address");
+			emitWord(state, op->value);
+			break;
+		case OP_ABS_L:
+			emit(state, 4, op->value);
+			break;
+		case OP_PC_DISP: {
+			const int32_t disp = op->value - (int32_t)state->pc;
+			checkRange(state, disp, -0x8000, 0x7FFF, "displacement");
+			emitWord(state, disp);
+			break;
+		}
+		case OP_PC_INDEX: {
+			const int32_t disp = op->value - (int32_t)state->pc;
+			checkRange(state, disp, -0x80, 0x7F, "displacement");
+			emitWord(state, (op->indexReg << 12) | (op->indexLong << 11) | (disp & 0xFF));
+			break;
+		}
+		case OP_IMMEDIATE:
+			if (size == 4) {
+				emit(state, 4, op->value);
+			}
+			else {
+				checkRange(state, op->value, (size == 1) ? -0x80 : -0x8000, (size == 1) ? 0xFF : 0xFFFF, "immediate");
+				emitWord(state, op->value & ((size == 1) ? 0xFF : 0xFFFF));
+			}
+			break;
+	}
+}
+
+static int isMemory(const asmOperand * op) {
+	return (op->kind >= OP_IND) && (op->kind <= OP_PC_INDEX);
+}
+
+static int isAlterable(const asmOperand * op) {
+	return (op->kind <= OP_ABS_L);
+}
+
+static uint16_t sizeField(int size) {
+	return (size == 1) ? 0 : (size == 2) ? 1 : 2;
+}
+
+/* Condition codes for Bcc/DBcc */
+static int conditionCode(const char * name) {
+	static const char * const names[] = {
+		"t", "f", "hi", "ls", "cc", "cs", "ne", "eq", "vc", "vs", "pl", "mi", "ge", "lt", "gt", "le"
+	};
+
+	if (strcasecmp(name, "hs") == 0) return 0x4;
+	if (strcasecmp(name, "lo") == 0) return 0x5;
+	if (strcasecmp(name, "ra") == 0) return 0x0;
+
+	for (int i = 0; i < 16; ++i) {
+		if (strcasecmp(name, names[i]) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void requireOperands(asmState * state, int count, int expected) {
+	if (count != expected) {
+		asmError(state, "expected %d operand(s), got %d", expected, count);
+	}
+}
+
+/* ADD, SUB, AND, OR, CMP, EOR and their A/I forms */
+static void encodeArithmetic(asmState * state, const char * name, int size, asmOperand * src, asmOperand * dst) {
+	static const struct { const char * name; uint16_t base; uint16_t immediate; } ops[] = {
+		{ "or", 0x8000, 0x0000 }, { "sub", 0x9000, 0x0400 }, { "cmp", 0xB000, 0x0C00 },
+		{ "and", 0xC000, 0x0200 }, { "add", 0xD000, 0x0600 }, { "eor", 0xB100, 0x0A00 }
+	};
+
+	int index = -1;
+	size_t length = strlen(name);
+	char suffix = '\0';
+
+	for (int i = 0; i < 6; ++i) {
+		const size_t opLength = strlen(ops[i].name);
+		if ((strncasecmp(name, ops[i].name, opLength) == 0) && (length <= opLength + 1)) {
+			index = i;
+			suffix = tolower((unsigned char)name[opLength]);
+		}
+	}
+
+	if (index < 0) {
+		asmError(state, "unknown instruction '%s'", name);
+		return;
+	}
+
+	const uint16_t base = ops[index].base;
+	const int isEor = (index == 5);
+
+	if ((dst->kind == OP_AREG) && (suffix == '\0' || suffix == 'a') && (base == 0x9000 || base == 0xB000 || base == 0xD000)) {
+		if (size == 1) {
+			asmError(state, "byte size isn't allowed for address registers");
+		}
+		emitWord(state, base | (dst->reg << 9) | ((size == 4) ? 0x1C0 : 0x0C0) | eaField(state, src));
+		eaExtension(state, src, size);
+	}
+	else if ((src->kind == OP_IMMEDIATE) && (suffix == '\0' || suffix == 'i')) {
+		if (!isAlterable(dst) || (dst->kind == OP_AREG)) {
+			asmError(state, "bad destination operand");
+		}
+		emitWord(state, ops[index].immediate | (sizeField(size) << 6) | eaField(state, dst));
+		eaExtension(state, src, size);
+		eaExtension(state, dst, size);
+	}
+	else if ((dst->kind == OP_DREG) && !isEor && (suffix == '\0')) {
+		if ((src->kind == OP_AREG) && (size == 1)) {
+			asmError(state, "byte size isn't allowed for address registers");
+		}
+		emitWord(state, base | (dst->reg << 9) | (sizeField(size) << 6) | eaField(state, src));
+		eaExtension(state, src, size);
+	}
+	else if ((src->kind == OP_DREG) && (base != 0xB000) && (suffix == '\0') && isAlterable(dst) && (dst->kind != OP_AREG)) {
+		emitWord(state, base | (src->reg << 9) | (isEor ? 0 : 0x100) | (sizeField(size) << 6) | eaField(state, dst));
+		eaExtension(state, dst, size);
+	}
+	else {
+		asmError(state, "bad operands for '%s'", name);
+	}
+}
+
+/*
+ * Assembles a single instruction
+ */
+static void assembleInstruction(asmState * state, char * mnemonic, asmOperand * ops, int count) {
+	int size = 2;
+	char * dot = strchr(mnemonic, '.');
+	int shortBranch = 0;
+
+	if (dot) {
+		*dot = '\0';
+		switch (tolower((unsigned char)dot[1])) {
+			case 'b': size = 1; break;
+			case 'w': size = 2; break;
+			case 'l': size = 4; break;
+			case 's': size = 1; break;
+			default: asmError(state, "bad size suffix"); return;
+		}
+		shortBranch = (size == 1);
+	}
+
+	for (char * p = mnemonic; *p; ++p) {
+		*p = tolower((unsigned char)*p);
+	}
+
+	const uint32_t start = state->pc;
+
+	if ((strcmp(mnemonic, "move") == 0) || (strcmp(mnemonic, "movea") == 0)) {
+		requireOperands(state, count, 2);
+		if ((ops[1].kind == OP_AREG) && (size == 1)) {
+			asmError(state, "byte size isn't allowed for address registers");
+		}
+		if (!isAlterable(&ops[1])) {
+			asmError(state, "bad destination operand");
+		}
+		const uint16_t dstField = eaField(state, &ops[1]);
+		const uint16_t sizeBits = (size == 1) ? 1 : (size == 2) ? 3 : 2;
+		emitWord(state, (sizeBits << 12) | ((dstField & 7) << 9) | ((dstField >> 3) << 6) | eaField(state, &ops[0]));
+		eaExtension(state, &ops[0], size);
+		eaExtension(state, &ops[1], size);
+	}
+	else if (strcmp(mnemonic, "moveq") == 0) {
+		requireOperands(state, count, 2);
+		if ((ops[0].kind != OP_IMMEDIATE) || (ops[1].kind != OP_DREG)) {
+			asmError(state, "bad operands for 'moveq'");
+		}
+		checkRange(state, ops[0].value, -0x80, 0xFF, "immediate");
+		emitWord(state, 0x7000 | (ops[1].reg << 9) | (ops[0].value & 0xFF));
+	}
+	else if (strcmp(mnemonic, "lea") == 0) {
+		requireOperands(state, count, 2);
+		if (!isMemory(&ops[0]) || (ops[0].kind == OP_POSTINC) || (ops[0].kind == OP_PREDEC) || (ops[1].kind != OP_AREG)) {
+			asmError(state, "bad operands for 'lea'");
+		}
+		emitWord(state, 0x41C0 | (ops[1].reg << 9) | eaField(state, &ops[0]));
+		eaExtension(state, &ops[0], 4);
+	}
+	else if ((strcmp(mnemonic, "jmp") == 0) || (strcmp(mnemonic, "jsr") == 0)) {
+		requireOperands(state, count, 1);
+		if (!isMemory(&ops[0]) || (ops[0].kind == OP_POSTINC) || (ops[0].kind == OP_PREDEC)) {
+			asmError(state, "bad operand for '%s'", mnemonic);
+		}
+		emitWord(state, ((mnemonic[1] == 'm') ? 0x4EC0 : 0x4E80) | eaField(state, &ops[0]));
+		eaExtension(state, &ops[0], 4);
+	}
+	else if (strcmp(mnemonic, "rts") == 0) {
+		requireOperands(state, count, 0);
+		emitWord(state, 0x4E75);
+	}
+	else if (strcmp(mnemonic, "nop") == 0) {
+		requireOperands(state, count, 0);
+		emitWord(state, 0x4E71);
+	}
+	else if ((mnemonic[0] == 'b') && ((strcmp(mnemonic, "bsr") == 0) || (conditionCode(mnemonic + 1) >= 0))
+			&& (strcmp(mnemonic, "bf") != 0) && (strcmp(mnemonic, "bt") != 0)) {
+		requireOperands(state, count, 1);
+		const int condition = (strcmp(mnemonic, "bsr") == 0) ? 1 : conditionCode(mnemonic + 1);
+		const int32_t disp = ops[0].value - (int32_t)(start + 2);
+
+		if (shortBranch) {
+			if (state->pass == 2 && ((disp < -0x80) || (disp > 0x7F) || (disp == 0))) {
+				asmError(state, "short branch out of range: %d", disp);
+			}
+			emitWord(state, 0x6000 | (condition << 8) | (disp & 0xFF));
+		}
+		else {
+			emitWord(state, 0x6000 | (condition << 8));
+			checkRange(state, disp, -0x8000, 0x7FFF, "branch");
+			emitWord(state, disp);
+		}
+	}
+	else if ((mnemonic[0] == 'd') && (mnemonic[1] == 'b') && ((strcmp(mnemonic, "dbra") == 0) || (conditionCode(mnemonic + 2) >= 0))) {
+		requireOperands(state, count, 2);
+		if (ops[0].kind != OP_DREG) {
+			asmError(state, "bad operands for '%s'", mnemonic);
+		}
+		const int condition = (strcmp(mnemonic, "dbra") == 0) ? 1 : conditionCode(mnemonic + 2);
+		const int32_t disp = ops[1].value - (int32_t)(start + 2);
+		emitWord(state, 0x50C8 | (condition << 8) | ops[0].reg);
+		checkRange(state, disp, -0x8000, 0x7FFF, "branch");
+		emitWord(state, disp);
+	}
+	else if ((strlen(mnemonic) == 3) && (strstr("asl asr lsl lsr rol ror", mnemonic) != NULL)) {
+		requireOperands(state, count, 2);
+		const uint16_t type = (mnemonic[0] == 'a') ? 0 : (mnemonic[0] == 'l') ? 1 : 3;
+		const uint16_t left = (mnemonic[2] == 'l') ? 0x100 : 0;
+
+		if (ops[1].kind != OP_DREG) {
+			asmError(state, "only data register shifts are supported");
+		}
+
+		if (ops[0].kind == OP_IMMEDIATE) {
+			checkRange(state, ops[0].value, 1, 8, "shift count");
+			emitWord(state, 0xE000 | ((ops[0].value & 7) << 9) | left | (sizeField(size) << 6) | (type << 3) | ops[1].reg);
+		}
+		else if (ops[0].kind == OP_DREG) {
+			emitWord(state, 0xE020 | (ops[0].reg << 9) | left | (sizeField(size) << 6) | (type << 3) | ops[1].reg);
+		}
+		else {
+			asmError(state, "bad shift count");
+		}
+	}
+	else if ((strcmp(mnemonic, "addq") == 0) || (strcmp(mnemonic, "subq") == 0)) {
+		requireOperands(state, count, 2);
+		if ((ops[0].kind != OP_IMMEDIATE) || !isAlterable(&ops[1])) {
+			asmError(state, "bad operands for '%s'", mnemonic);
+		}
+		checkRange(state, ops[0].value, 1, 8, "immediate");
+		emitWord(state, 0x5000 | ((ops[0].value & 7) << 9) | ((mnemonic[0] == 's') ? 0x100 : 0) | (sizeField(size) << 6) | eaField(state, &ops[1]));
+		eaExtension(state, &ops[1], size);
+	}
+	else if ((strncmp(mnemonic, "add", 3) == 0) || (strncmp(mnemonic, "sub", 3) == 0) || (strncmp(mnemonic, "cmp", 3) == 0)
+			|| (strncmp(mnemonic, "and", 3) == 0) || (strncmp(mnemonic, "or", 2) == 0) || (strncmp(mnemonic, "eor", 3) == 0)) {
+		requireOperands(state, count, 2);
+		if (!state->failed) {
+			encodeArithmetic(state, mnemonic, size, &ops[0], &ops[1]);
+		}
+	}
+	else if ((strcmp(mnemonic, "tst") == 0) || (strcmp(mnemonic, "clr") == 0) || (strcmp(mnemonic, "neg") == 0) || (strcmp(mnemonic, "not") == 0)) {
+		requireOperands(state, count, 1);
+		const uint16_t base = (mnemonic[0] == 't') ? 0x4A00 : (mnemonic[0] == 'c') ? 0x4200 : (mnemonic[1] == 'e') ? 0x4400 : 0x4600;
+		if (!isAlterable(&ops[0]) || (ops[0].kind == OP_AREG)) {
+			asmError(state, "bad operand for '%s'", mnemonic);
+		}
+		emitWord(state, base | (sizeField(size) << 6) | eaField(state, &ops[0]));
+		eaExtension(state, &ops[0], size);
+	}
+	else if (strcmp(mnemonic, "ext") == 0) {
+		requireOperands(state, count, 1);
+		if ((ops[0].kind != OP_DREG) || (size == 1)) {
+			asmError(state, "bad operand for 'ext'");
+		}
+		emitWord(state, ((size == 4) ? 0x48C0 : 0x4880) | ops[0].reg);
+	}
+	else if (strcmp(mnemonic, "swap") == 0) {
+		requireOperands(state, count, 1);
+		if (ops[0].kind != OP_DREG) {
+			asmError(state, "bad operand for 'swap'");
+		}
+		emitWord(state, 0x4840 | ops[0].reg);
+	}
+	else if ((strcmp(mnemonic, "btst") == 0) || (strcmp(mnemonic, "bchg") == 0) || (strcmp(mnemonic, "bclr") == 0) || (strcmp(mnemonic, "bset") == 0)) {
+		requireOperands(state, count, 2);
+		const uint16_t operation = (mnemonic[1] == 't') ? 0 : (mnemonic[2] == 'h') ? 1 : (mnemonic[2] == 'l') ? 2 : 3;
+
+		if (ops[0].kind == OP_IMMEDIATE) {
+			emitWord(state, 0x0800 | (operation << 6) | eaField(state, &ops[1]));
+			emitWord(state, ops[0].value & 0xFF);
+		}
+		else if (ops[0].kind == OP_DREG) {
+			emitWord(state, 0x0100 | (ops[0].reg << 9) | (operation << 6) | eaField(state, &ops[1]));
+		}
+		else {
+			asmError(state, "bad bit number");
+		}
+		eaExtension(state, &ops[1], 1);
+	}
+	else if (strcmp(mnemonic, "movem") == 0) {
+		requireOperands(state, count, 2);
+		if (size == 1) {
+			asmError(state, "byte size isn't allowed for 'movem'");
+		}
+
+		const int toRegisters = (ops[1].regMask != 0) && (ops[0].regMask == 0);
+		const asmOperand * list = toRegisters ? &ops[1] : &ops[0];
+		const asmOperand * ea = toRegisters ? &ops[0] : &ops[1];
+		uint16_t mask = list->regMask;
+
+		if (!mask || !isMemory(ea) || (toRegisters ? (ea->kind == OP_PREDEC) : (ea->kind == OP_POSTINC || ea->kind >= OP_PC_DISP))) {
+			asmError(state, "bad operands for 'movem'");
+		}
+
+		if (ea->kind == OP_PREDEC) {		// reversed mask for pre-decrement mode
+			uint16_t reversed = 0;
+			for (int i = 0; i < 16; ++i) {
+				if (mask & (1 << i)) {
+					reversed |= 0x8000 >> i;
+				}
+			}
+			mask = reversed;
+		}
+
+		emitWord(state, 0x4880 | (toRegisters ? 0x400 : 0) | ((size == 4) ? 0x40 : 0) | eaField(state, ea));
+		emitWord(state, mask);
+		eaExtension(state, ea, size);
+	}
+	else if (strcmp(mnemonic, "exg") == 0) {
+		requireOperands(state, count, 2);
+		asmOperand * x = &ops[0];
+		asmOperand * y = &ops[1];
+
+		if ((x->kind == OP_AREG) && (y->kind == OP_DREG)) {
+			x = &ops[1];
+			y = &ops[0];
+		}
+
+		if ((x->kind == OP_DREG) && (y->kind == OP_DREG)) {
+			emitWord(state, 0xC140 | (x->reg << 9) | y->reg);
+		}
+		else if ((x->kind == OP_AREG) && (y->kind == OP_AREG)) {
+			emitWord(state, 0xC148 | (x->reg << 9) | y->reg);
+		}
+		else if ((x->kind == OP_DREG) && (y->kind == OP_AREG)) {
+			emitWord(state, 0xC188 | (x->reg << 9) | y->reg);
+		}
+		else {
+			asmError(state, "bad operands for 'exg'");
+		}
+	}
+	else {
+		asmError(state, "unknown instruction '%s'", mnemonic);
+	}
+}
+
+/*
+ * Assembles "dc" and "ds" directives
+ */
+static void assembleData(asmState * state, const char * mnemonic, char ** operands, int count) {
+	const char * dot = strchr(mnemonic, '.');
+	const char suffix = dot ? tolower((unsigned char)dot[1]) : 'w';
+	const int size = (suffix == 'b') ? 1 : (suffix == 'l') ? 4 : 2;
+
+	if ((size > 1) && (state->pc & 1)) {
+		asmError(state, "misaligned data");
+	}
+
+	if (tolower((unsigned char)mnemonic[1]) == 's') {
+		requireOperands(state, count, 1);
+		const int32_t length = evaluate(state, operands[0]);
+		for (int32_t i = 0; i < length; ++i) {
+			emit(state, size, 0);
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		emit(state, size, evaluate(state, operands[i]));
+	}
+}
+
+/* Splits operands on top-level commas */
+static int splitOperands(char * text, char ** operands) {
+	int count = 0;
+	int depth = 0;
+	char * start = (char *)skipSpaces(text);
+
+	if (*start == '\0') {
+		return 0;
+	}
+
+	for (char * p = start;; ++p) {
+		if (*p == '(') {
+			depth++;
+		}
+		else if (*p == ')') {
+			depth--;
+		}
+		else if (((*p == ',') && (depth == 0)) || (*p == '\0')) {
+			const int end = (*p == '\0');
+			char * last = p;
+			*p = '\0';
+
+			while ((last > start) && (last[-1] == ' ' || last[-1] == '\t')) {
+				*--last = '\0';
+			}
+
+			if (count < ASM_MAX_OPERANDS) {
+				operands[count++] = start;
+			}
+
+			if (end) {
+				break;
+			}
+			start = (char *)skipSpaces(p + 1);
+			p = start - 1;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Assembles a single source line
+ */
+static void assembleLine(asmState * state, char * line) {
+	char label[ASM_MAX_SYMBOL_LENGTH] = "";
+	char * p = line;
+
+	// Strip comments
+	for (char * c = line; *c; ++c) {
+		if (*c == ';') {
+			*c = '\0';
+			break;
+		}
+	}
+
+	// Label in the first column
+	if ((*p != ' ') && (*p != '\t') && (*p != '\0')) {
+		size_t length = 0;
+
+		while (isSymbolChar(*p, length == 0) && (*p != '.' || length == 0)) {
+			if (length < sizeof(label) - 1) {
+				label[length++] = *p;
+			}
+			p++;
+		}
+		label[length] = '\0';
+
+		if (length == 0) {
+			asmError(state, "bad label");
+			return;
+		}
+
+		if (*p == ':') {
+			p++;
+		}
+	}
+
+	// Mnemonic
+	p = (char *)skipSpaces(p);
+	char * mnemonic = p;
+
+	while (*p && (*p != ' ') && (*p != '\t')) {
+		p++;
+	}
+	if (*p) {
+		*p++ = '\0';
+	}
+
+	// Constants
+	if ((strcasecmp(mnemonic, "equ") == 0) || (strcmp(mnemonic, "=") == 0)) {
+		if (label[0] == '\0') {
+			asmError(state, "constant without a name");
+			return;
+		}
+		char * value = (char *)skipSpaces(p);
+		size_t length = strlen(value);
+		while (length && (value[length - 1] == ' ' || value[length - 1] == '\t')) {
+			value[--length] = '\0';
+		}
+		defineSymbol(state, label, evaluate(state, value), 0);
+		return;
+	}
+
+	if (label[0]) {
+		defineSymbol(state, label, state->pc, 1);
+	}
+
+	if (*mnemonic == '\0') {
+		return;
+	}
+
+	char * operandTexts[ASM_MAX_OPERANDS];
+	const int count = splitOperands(p, operandTexts);
+
+	if ((strncasecmp(mnemonic, "dc.", 3) == 0) || (strncasecmp(mnemonic, "ds.", 3) == 0)) {
+		assembleData(state, mnemonic, operandTexts, count);
+		return;
+	}
+
+	if (strcasecmp(mnemonic, "even") == 0) {
+		if (state->pc & 1) {
+			emit(state, 1, 0);
+		}
+		return;
+	}
+
+	if (strcasecmp(mnemonic, "end") == 0) {
+		return;
+	}
+
+	asmOperand operands[ASM_MAX_OPERANDS];
+
+	for (int i = 0; i < count; ++i) {
+		parseOperand(state, operandTexts[i], &operands[i]);
+	}
+
+	if (state->pc & 1) {
+		asmError(state, "instruction at odd address");
+	}
+
+	assembleInstruction(state, mnemonic, operands, count);
+}
+
+/*
+ * Assembles file into the 16 MB memory image at the given origin
+ */
+int asmAssembleFile(asmProgram * program, const char * path, uint8_t * memory, uint32_t origin) {
+	memset(program, 0, sizeof(*program));
+	program->origin = origin;
+
+	FILE * file = fopen(path, "r");
+
+	if (!file) {
+		snprintf(program->error, sizeof(program->error), "couldn't open '%s'", path);
+		return -1;
+	}
+
+	asmState state = { .program = program, .memory = memory };
+
+	for (state.pass = 1; state.pass <= 2; ++state.pass) {
+		char line[ASM_MAX_LINE];
+
+		rewind(file);
+		state.pc = origin;
+		state.line = 0;
+		state.scope[0] = '\0';
+
+		while (!state.failed && fgets(line, sizeof(line), file)) {
+			state.line++;
+			line[strcspn(line, "\r\n")] = '\0';
+			assembleLine(&state, line);
+		}
+	}
+
+	fclose(file);
+	program->size = state.pc - origin;
+
+	return state.failed ? -1 : 0;
+}
+
+int asmFindSymbol(const asmProgram * program, const char * name, uint32_t * value) {
+	asmSymbol * symbol = findSymbol((asmProgram *)program, name);
+
+	if (!symbol) {
+		return -1;
+	}
+
+	*value = symbol->value;
+	return 0;
+}
+
+void asmFree(asmProgram * program) {
+	free(program->symbols);
+	program->symbols = NULL;
+	program->symbolCount = 0;
+	program->symbolCapacity = 0;
+}
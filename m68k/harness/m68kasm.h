@@ -0,0 +1,28 @@
+
+/* ================================================================================= *
+ * Minimal ASM68K-syntax assembler for testing the M68K decompressors				 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stdint.h>
+
+#define ASM_MAX_SYMBOL_LENGTH	64
+
+typedef struct {
+	char name[ASM_MAX_SYMBOL_LENGTH];
+	int32_t value;
+} asmSymbol;
+
+typedef struct {
+	asmSymbol * symbols;
+	int symbolCount;
+	int symbolCapacity;
+	uint32_t origin;			// address the program was assembled at
+	uint32_t size;				// size of the assembled program
+	char error[256];			// error message if assembly failed
+} asmProgram;
+
+int asmAssembleFile(asmProgram * program, const char * path, uint8_t * memory, uint32_t origin);
+int asmFindSymbol(const asmProgram * program, const char * name, uint32_t * value);
+void asmFree(asmProgram * program);
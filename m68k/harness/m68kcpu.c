@@ -0,0 +1,837 @@
+
+/* ================================================================================= *
+ * Minimal M68000 CPU emulator for testing the M68K decompressors					 *
+ *																					 *
+ * Only user mode integer instructions are implemented, which is enough to run		 *
+ * the decompressors. Anything else stops execution with CPU_ILLEGAL_INSTRUCTION.	 *
+ * Clock cycles are counted according to the M68000 User's Manual timing tables	 *
+ * (no wait states, no prefetch effects).											 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "m68kcpu.h"
+
+/* Return address pushed by "cpuCall", execution stops once it's reached */
+#define CALL_SENTINEL	0xFFFFFE
+
+/* Effective address kinds */
+#define EA_DREG		0
+#define EA_AREG		1
+#define EA_MEMORY	2
+#define EA_IMMEDIATE	3
+
+typedef struct {
+	int kind;
+	int reg;
+	uint32_t address;		// for EA_MEMORY
+	uint32_t value;			// for EA_IMMEDIATE
+	int cycles;				// effective address calculation time
+} effAddr;
+
+/* Execution state of the current instruction */
+typedef struct {
+	m68kCpu * cpu;
+	int error;
+	int cycles;
+} execState;
+
+#define MASK(size)		((size) == 1 ? 0xFFu : (size) == 2 ? 0xFFFFu : 0xFFFFFFFFu)
+#define SIGN_BIT(size)	((size) == 1 ? 0x80u : (size) == 2 ? 0x8000u : 0x80000000u)
+#define SIZE_BITS(bits)	((bits) == 0 ? 1 : (bits) == 1 ? 2 : (bits) == 2 ? 4 : 0)
+
+/*
+ * Allocates CPU memory and resets registers
+ */
+int cpuInit(m68kCpu * cpu) {
+	cpu->memory = calloc(CPU_MEMORY_SIZE, 1);
+
+	for (int i = 0; i < 8; ++i) {
+		cpu->d[i] = 0;
+		cpu->a[i] = 0;
+	}
+
+	cpu->pc = 0;
+	cpu->sr = 0x2700;
+	cpu->instructions = 0;
+	cpu->cycles = 0;
+
+	return (cpu->memory != NULL) ? 0 : -1;
+}
+
+void cpuFree(m68kCpu * cpu) {
+	free(cpu->memory);
+	cpu->memory = NULL;
+}
+
+/*
+ * Reads big-endian value of the given size (1, 2 or 4 bytes)
+ */
+uint32_t cpuRead(m68kCpu * cpu, uint32_t address, int size) {
+	uint32_t value = 0;
+
+	for (int i = 0; i < size; ++i) {
+		value = (value << 8) | cpu->memory[(address + i) & CPU_ADDRESS_MASK];
+	}
+
+	return value;
+}
+
+/*
+ * Writes big-endian value of the given size (1, 2 or 4 bytes)
+ */
+void cpuWrite(m68kCpu * cpu, uint32_t address, int size, uint32_t value) {
+	for (int i = size - 1; i >= 0; --i, value >>= 8) {
+		cpu->memory[(address + i) & CPU_ADDRESS_MASK] = value;
+	}
+}
+
+static uint32_t memRead(execState * state, uint32_t address, int size) {
+	if ((size > 1) && (address & 1)) {
+		state->error = CPU_ADDRESS_ERROR;
+		return 0;
+	}
+
+	return cpuRead(state->cpu, address, size);
+}
+
+static void memWrite(execState * state, uint32_t address, int size, uint32_t value) {
+	if ((size > 1) && (address & 1)) {
+		state->error = CPU_ADDRESS_ERROR;
+		return;
+	}
+
+	cpuWrite(state->cpu, address, size, value);
+}
+
+static uint16_t fetchWord(execState * state) {
+	uint16_t value = memRead(state, state->cpu->pc, 2);
+	state->cpu->pc += 2;
+	return value;
+}
+
+static uint32_t fetchLong(execState * state) {
+	uint32_t value = memRead(state, state->cpu->pc, 4);
+	state->cpu->pc += 4;
+	return value;
+}
+
+static uint32_t signExtend(uint32_t value, int size) {
+	value &= MASK(size);
+	return (value & SIGN_BIT(size)) ? (value | ~MASK(size)) : value;
+}
+
+/* Brief extension word: d8(An,Xn) and d8(PC,Xn) */
+static uint32_t indexOffset(execState * state) {
+	const uint16_t ext = fetchWord(state);
+	const int reg = (ext >> 12) & 7;
+	uint32_t index = (ext & 0x8000) ? state->cpu->a[reg] : state->cpu->d[reg];
+
+	if (!(ext & 0x0800)) {
+		index = signExtend(index, 2);
+	}
+
+	return index + signExtend(ext, 1);
+}
+
+/*
+ * Returns effective address calculation time
+ */
+static int eaCycles(int mode, int reg, int size) {
+	// Dn, An, (An), (An)+, -(An), d16(An), d8(An,Xn), xxx.w, xxx.l, d16(PC), d8(PC,Xn), #xxx
+	static const int cycles[12] = { 0, 0, 4, 4, 6, 8, 10, 8, 12, 8, 10, 4 };
+	const int index = (mode < 7) ? mode : 7 + reg;
+
+	if (index >= 12) {
+		return 0;
+	}
+
+	return cycles[index] + (((size == 4) && (index >= 2)) ? 4 : 0);
+}
+
+/*
+ * Returns execution time of instructions using control addressing modes
+ * (LEA, JMP, JSR), `table` lists (An), d16(An), d8(An,Xn), xxx.w, xxx.l, d16(PC), d8(PC,Xn)
+ */
+static int controlCycles(int mode, int reg, const int * table) {
+	return (mode < 7) ? table[mode - 2] : table[3 + (reg & 3)];
+}
+
+/*
+ * Decodes effective address, applying pre-decrement and post-increment
+ */
+static effAddr decodeEA(execState * state, int mode, int reg, int size) {
+	m68kCpu * cpu = state->cpu;
+	effAddr ea = { .kind = EA_MEMORY, .reg = reg, .address = 0, .value = 0, .cycles = eaCycles(mode, reg, size) };
+	const int step = ((reg == 7) && (size == 1)) ? 2 : size;	// stack pointer stays even
+
+	switch (mode) {
+		case 0: ea.kind = EA_DREG; break;
+		case 1: ea.kind = EA_AREG; break;
+		case 2: ea.address = cpu->a[reg]; break;
+		case 3: ea.address = cpu->a[reg]; cpu->a[reg] += step; break;
+		case 4: cpu->a[reg] -= step; ea.address = cpu->a[reg]; break;
+		case 5: ea.address = cpu->a[reg] + signExtend(fetchWord(state), 2); break;
+		case 6: ea.address = cpu->a[reg] + indexOffset(state); break;
+		case 7:
+			switch (reg) {
+				case 0: ea.address = signExtend(fetchWord(state), 2); break;
+				case 1: ea.address = fetchLong(state); break;
+				case 2: ea.address = cpu->pc; ea.address += signExtend(fetchWord(state), 2); break;
+				case 3: ea.address = cpu->pc; ea.address += indexOffset(state); break;
+				case 4:
+					ea.kind = EA_IMMEDIATE;
+					ea.value = (size == 4) ? fetchLong(state) : (fetchWord(state) & MASK(size));
+					break;
+				default: state->error = CPU_ILLEGAL_INSTRUCTION; break;
+			}
+			break;
+	}
+
+	return ea;
+}
+
+static uint32_t readEA(execState * state, const effAddr * ea, int size) {
+	switch (ea->kind) {
+		case EA_DREG: return state->cpu->d[ea->reg] & MASK(size);
+		case EA_AREG: return state->cpu->a[ea->reg] & MASK(size);
+		case EA_IMMEDIATE: return ea->value;
+		default: return memRead(state, ea->address, size);
+	}
+}
+
+static void writeEA(execState * state, const effAddr * ea, int size, uint32_t value) {
+	switch (ea->kind) {
+		case EA_DREG:
+			state->cpu->d[ea->reg] = (state->cpu->d[ea->reg] & ~MASK(size)) | (value & MASK(size));
+			break;
+		case EA_AREG:
+			state->cpu->a[ea->reg] = signExtend(value, size);
+			break;
+		case EA_IMMEDIATE:
+			state->error = CPU_ILLEGAL_INSTRUCTION;
+			break;
+		default:
+			memWrite(state, ea->address, size, value);
+			break;
+	}
+}
+
+/* Flag helpers */
+static void setFlags(m68kCpu * cpu, uint16_t mask, uint16_t flags) {
+	cpu->sr = (cpu->sr & ~mask) | (flags & mask);
+}
+
+static void setLogicFlags(m68kCpu * cpu, uint32_t result, int size) {
+	result &= MASK(size);
+	setFlags(cpu, CCR_N | CCR_Z | CCR_V | CCR_C, ((result & SIGN_BIT(size)) ? CCR_N : 0) | (result ? 0 : CCR_Z));
+}
+
+static uint32_t doAdd(m68kCpu * cpu, uint32_t dst, uint32_t src, int size, int withX) {
+	const uint64_t sum = (uint64_t)(dst & MASK(size)) + (src & MASK(size));
+	const uint32_t result = sum & MASK(size);
+	const int carry = (sum >> (size * 8)) & 1;
+	const int overflow = ((~(dst ^ src) & (dst ^ result)) & SIGN_BIT(size)) != 0;
+
+	setFlags(cpu, CCR_N | CCR_Z | CCR_V | CCR_C | (withX ? CCR_X : 0),
+		((result & SIGN_BIT(size)) ? CCR_N : 0) | (result ? 0 : CCR_Z) | (overflow ? CCR_V : 0) | (carry ? (CCR_C | CCR_X) : 0));
+
+	return result;
+}
+
+static uint32_t doSub(m68kCpu * cpu, uint32_t dst, uint32_t src, int size, int withX) {
+	const uint32_t result = (dst - src) & MASK(size);
+	const int borrow = (src & MASK(size)) > (dst & MASK(size));
+	const int overflow = (((dst ^ src) & (dst ^ result)) & SIGN_BIT(size)) != 0;
+
+	setFlags(cpu, CCR_N | CCR_Z | CCR_V | CCR_C | (withX ? CCR_X : 0),
+		((result & SIGN_BIT(size)) ? CCR_N : 0) | (result ? 0 : CCR_Z) | (overflow ? CCR_V : 0) | (borrow ? (CCR_C | CCR_X) : 0));
+
+	return result;
+}
+
+static int testCondition(m68kCpu * cpu, int condition) {
+	const int c = (cpu->sr & CCR_C) != 0;
+	const int v = (cpu->sr & CCR_V) != 0;
+	const int z = (cpu->sr & CCR_Z) != 0;
+	const int n = (cpu->sr & CCR_N) != 0;
+
+	switch (condition) {
+		case 0x0: return 1;
+		case 0x1: return 0;
+		case 0x2: return !c && !z;
+		case 0x3: return c || z;
+		case 0x4: return !c;
+		case 0x5: return c;
+		case 0x6: return !z;
+		case 0x7: return z;
+		case 0x8: return !v;
+		case 0x9: return v;
+		case 0xA: return !n;
+		case 0xB: return n;
+		case 0xC: return n == v;
+		case 0xD: return n != v;
+		case 0xE: return !z && (n == v);
+		default: return z || (n != v);
+	}
+}
+
+/*
+ * Shift and rotate operations on data registers
+ */
+static void execShift(execState * state, uint16_t opcode) {
+	m68kCpu * cpu = state->cpu;
+	const int size = SIZE_BITS((opcode >> 6) & 3);
+	const int reg = opcode & 7;
+	const int left = (opcode >> 8) & 1;
+	const int type = (opcode >> 3) & 3;
+	const int count = (opcode & 0x20) ? (cpu->d[(opcode >> 9) & 7] & 63) : ((((opcode >> 9) - 1) & 7) + 1);
+
+	if ((size == 0) || (type == 2)) {		// memory shifts and ROXL/ROXR aren't supported
+		state->error = CPU_ILLEGAL_INSTRUCTION;
+		return;
+	}
+
+	uint32_t value = cpu->d[reg] & MASK(size);
+	uint16_t flags = cpu->sr & CCR_X;
+	int overflow = 0;
+
+	if (count > 0) {
+		flags = 0;
+		int lastBit = 0;
+
+		for (int i = 0; i < count; ++i) {
+			if (left) {
+				lastBit = (value & SIGN_BIT(size)) != 0;
+				value = (value << 1) & MASK(size);
+				if (type == 3) {
+					value |= lastBit;
+				}
+				if ((type == 0) && (lastBit != ((value & SIGN_BIT(size)) != 0))) {
+					overflow = 1;
+				}
+			}
+			else {
+				lastBit = value & 1;
+				if (type == 0) {
+					value = (value >> 1) | (value & SIGN_BIT(size));
+				}
+				else {
+					value = (value >> 1) | ((type == 3 && lastBit) ? SIGN_BIT(size) : 0);
+				}
+			}
+		}
+
+		flags |= lastBit ? CCR_C : 0;
+		flags |= (lastBit && (type != 3)) ? CCR_X : 0;
+		if (type == 3) {
+			flags |= cpu->sr & CCR_X;		// rotations keep X intact
+		}
+	}
+
+	flags |= (value & SIGN_BIT(size)) ? CCR_N : 0;
+	flags |= value ? 0 : CCR_Z;
+	flags |= overflow ? CCR_V : 0;
+
+	cpu->sr = (cpu->sr & 0xFF00) | flags;
+	cpu->d[reg] = (cpu->d[reg] & ~MASK(size)) | value;
+
+	state->cycles += ((size == 4) ? 8 : 6) + 2 * count;
+}
+
+/*
+ * MOVEM: moves register list to or from memory
+ */
+static void execMovem(execState * state, uint16_t opcode) {
+	m68kCpu * cpu = state->cpu;
+	const int size = (opcode & 0x40) ? 4 : 2;
+	const int toRegisters = (opcode >> 10) & 1;
+	const int mode = (opcode >> 3) & 7;
+	const int reg = opcode & 7;
+	const uint16_t mask = fetchWord(state);
+	int count = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		count += (mask >> i) & 1;
+	}
+
+	state->cycles += (toRegisters ? 12 : 8) + count * ((size == 4) ? 8 : 4);
+
+	if (mode == 4) {		// -(An): registers are stored in reverse order, mask is reversed too
+		for (int i = 0; i < 16; ++i) {
+			if (mask & (1 << i)) {
+				const int r = 15 - i;
+				cpu->a[reg] -= size;
+				memWrite(state, cpu->a[reg], size, (r < 8) ? cpu->d[r] : cpu->a[r - 8]);
+			}
+		}
+		return;
+	}
+
+	effAddr ea = { .kind = EA_MEMORY, .address = 0 };
+
+	if (mode == 3) {
+		ea.address = cpu->a[reg];
+	}
+	else {
+		ea = decodeEA(state, mode, reg, 2);
+
+		if (ea.kind != EA_MEMORY) {
+			state->error = CPU_ILLEGAL_INSTRUCTION;
+			return;
+		}
+
+		state->cycles += ea.cycles - 4;		// relative to (An)
+	}
+
+	uint32_t address = ea.address;
+
+	for (int r = 0; r < 16; ++r) {
+		if (mask & (1 << r)) {
+			if (toRegisters) {
+				const uint32_t value = signExtend(memRead(state, address, size), size);
+
+				if (r < 8) {
+					cpu->d[r] = (size == 4) ? value : ((cpu->d[r] & 0xFFFF0000) | (value & 0xFFFF));
+				}
+				else {
+					cpu->a[r - 8] = value;
+				}
+			}
+			else {
+				memWrite(state, address, size, (r < 8) ? cpu->d[r] : cpu->a[r - 8]);
+			}
+			address += size;
+		}
+	}
+
+	if (mode == 3) {
+		cpu->a[reg] = address;
+	}
+}
+
+/*
+ * Bit operations: BTST, BCHG, BCLR, BSET
+ */
+static void execBitOp(execState * state, uint16_t opcode, uint32_t bitNumber) {
+	m68kCpu * cpu = state->cpu;
+	const int mode = (opcode >> 3) & 7;
+	const int operation = (opcode >> 6) & 3;
+	const int size = (mode == 0) ? 4 : 1;
+	const effAddr ea = decodeEA(state, mode, opcode & 7, size);
+	const uint32_t bit = 1u << (bitNumber & (size * 8 - 1));
+	const int isStatic = !(opcode & 0x0100);
+	uint32_t value = readEA(state, &ea, size);
+
+	if (mode == 0) {
+		static const int cycles[4] = { 6, 8, 10, 8 };		// BTST, BCHG, BCLR, BSET
+		state->cycles += cycles[operation] + (isStatic ? 4 : 0);
+	}
+	else {
+		state->cycles += ((operation == 0) ? 4 : 8) + (isStatic ? 4 : 0) + ea.cycles;
+	}
+
+	setFlags(cpu, CCR_Z, (value & bit) ? 0 : CCR_Z);
+
+	switch (operation) {
+		case 1: value ^= bit; break;
+		case 2: value &= ~bit; break;
+		case 3: value |= bit; break;
+		default: return;
+	}
+
+	writeEA(state, &ea, size, value);
+}
+
+/*
+ * Executes a single instruction
+ */
+static int step(m68kCpu * cpu) {
+	execState state = { .cpu = cpu, .error = CPU_OK, .cycles = 0 };
+	execState * s = &state;
+
+	if (cpu->pc & 1) {
+		return CPU_ADDRESS_ERROR;
+	}
+
+	const uint16_t opcode = fetchWord(s);
+	const int mode = (opcode >> 3) & 7;
+	const int reg = opcode & 7;
+	const int reg2 = (opcode >> 9) & 7;
+
+	cpu->instructions++;
+
+	switch (opcode >> 12) {
+
+		case 0x0: {
+			if (opcode & 0x0100) {
+				if (mode == 1) {		// MOVEP
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+				execBitOp(s, opcode, cpu->d[reg2]);
+			}
+			else if ((opcode & 0x0F00) == 0x0800) {
+				execBitOp(s, opcode, fetchWord(s));
+			}
+			else {
+				// ORI, ANDI, SUBI, ADDI, EORI, CMPI
+				const int size = SIZE_BITS((opcode >> 6) & 3);
+				const int operation = (opcode >> 9) & 7;
+
+				if ((size == 0) || (mode == 1) || (operation == 4) || (operation == 7) || (opcode & 0x3F) == 0x3C) {
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+
+				const uint32_t imm = (size == 4) ? fetchLong(s) : (fetchWord(s) & MASK(size));
+				const effAddr ea = decodeEA(s, mode, reg, size);
+				const uint32_t value = readEA(s, &ea, size);
+
+				if (mode == 0) {
+					s->cycles += (size == 4) ? ((operation == 6) ? 14 : 16) : 8;
+				}
+				else {
+					s->cycles += ((size == 4) ? ((operation == 6) ? 12 : 20) : ((operation == 6) ? 8 : 12)) + ea.cycles;
+				}
+
+				switch (operation) {
+					case 0: setLogicFlags(cpu, value | imm, size); writeEA(s, &ea, size, value | imm); break;
+					case 1: setLogicFlags(cpu, value & imm, size); writeEA(s, &ea, size, value & imm); break;
+					case 2: writeEA(s, &ea, size, doSub(cpu, value, imm, size, 1)); break;
+					case 3: writeEA(s, &ea, size, doAdd(cpu, value, imm, size, 1)); break;
+					case 5: setLogicFlags(cpu, value ^ imm, size); writeEA(s, &ea, size, value ^ imm); break;
+					case 6: doSub(cpu, value, imm, size, 0); break;
+				}
+			}
+			break;
+		}
+
+		case 0x1: case 0x2: case 0x3: {
+			// MOVE, MOVEA
+			const int size = ((opcode >> 12) == 1) ? 1 : ((opcode >> 12) == 3) ? 2 : 4;
+			const int dstMode = (opcode >> 6) & 7;
+			const effAddr src = decodeEA(s, mode, reg, size);
+			const uint32_t value = readEA(s, &src, size);
+			const effAddr dst = decodeEA(s, dstMode, reg2, size);
+
+			// Writes don't take extra time for pre-decrement
+			s->cycles += 4 + src.cycles + dst.cycles - ((dstMode == 4) ? 2 : 0);
+
+			if (dstMode == 1) {
+				if (size == 1) {
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+				cpu->a[reg2] = signExtend(value, size);
+			}
+			else {
+				setLogicFlags(cpu, value, size);
+				writeEA(s, &dst, size, value);
+			}
+			break;
+		}
+
+		case 0x4: {
+			if ((opcode & 0x01C0) == 0x01C0) {		// LEA
+				static const int cycles[7] = { 4, 8, 12, 8, 12, 8, 12 };
+				const effAddr ea = decodeEA(s, mode, reg, 4);
+				if (ea.kind != EA_MEMORY) {
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+				cpu->a[reg2] = ea.address;
+				s->cycles += controlCycles(mode, reg, cycles);
+			}
+			else if (opcode == 0x4E71) {			// NOP
+				s->cycles += 4;
+			}
+			else if (opcode == 0x4E75) {			// RTS
+				cpu->pc = memRead(s, cpu->a[7], 4);
+				cpu->a[7] += 4;
+				s->cycles += 16;
+			}
+			else if ((opcode & 0xFF80) == 0x4E80) {	// JSR, JMP
+				static const int jmpCycles[7] = { 8, 10, 14, 10, 12, 10, 14 };
+				static const int jsrCycles[7] = { 16, 18, 22, 18, 20, 18, 22 };
+				const effAddr ea = decodeEA(s, mode, reg, 4);
+				if (ea.kind != EA_MEMORY) {
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+				s->cycles += controlCycles(mode, reg, (opcode & 0x40) ? jmpCycles : jsrCycles);
+				if (!(opcode & 0x40)) {
+					cpu->a[7] -= 4;
+					memWrite(s, cpu->a[7], 4, cpu->pc);
+				}
+				cpu->pc = ea.address;
+			}
+			else if ((opcode & 0xFFF8) == 0x4840) {	// SWAP
+				cpu->d[reg] = (cpu->d[reg] >> 16) | (cpu->d[reg] << 16);
+				setLogicFlags(cpu, cpu->d[reg], 4);
+				s->cycles += 4;
+			}
+			else if ((opcode & 0xFFB8) == 0x4880) {	// EXT
+				s->cycles += 4;
+				if (opcode & 0x40) {
+					cpu->d[reg] = signExtend(cpu->d[reg], 2);
+					setLogicFlags(cpu, cpu->d[reg], 4);
+				}
+				else {
+					cpu->d[reg] = (cpu->d[reg] & 0xFFFF0000) | (signExtend(cpu->d[reg], 1) & 0xFFFF);
+					setLogicFlags(cpu, cpu->d[reg], 2);
+				}
+			}
+			else if ((opcode & 0xFB80) == 0x4880) {	// MOVEM
+				execMovem(s, opcode);
+			}
+			else if (((opcode & 0xFF00) == 0x4200) || ((opcode & 0xFF00) == 0x4400) || ((opcode & 0xFF00) == 0x4600) || ((opcode & 0xFF00) == 0x4A00)) {
+				// CLR, NEG, NOT, TST
+				const int size = SIZE_BITS((opcode >> 6) & 3);
+				if (size == 0) {
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+
+				const effAddr ea = decodeEA(s, mode, reg, size);
+				const uint32_t value = readEA(s, &ea, size);
+
+				if ((opcode & 0xFF00) == 0x4A00) {
+					s->cycles += 4 + ea.cycles;
+				}
+				else if (mode == 0) {
+					s->cycles += (size == 4) ? 6 : 4;
+				}
+				else {
+					s->cycles += ((size == 4) ? 12 : 8) + ea.cycles;
+				}
+
+				switch ((opcode >> 8) & 0xF) {
+					case 0x2: setLogicFlags(cpu, 0, size); writeEA(s, &ea, size, 0); break;
+					case 0x4: writeEA(s, &ea, size, doSub(cpu, 0, value, size, 1)); break;
+					case 0x6: setLogicFlags(cpu, ~value, size); writeEA(s, &ea, size, ~value); break;
+					default: setLogicFlags(cpu, value, size); break;
+				}
+			}
+			else {
+				return CPU_ILLEGAL_INSTRUCTION;
+			}
+			break;
+		}
+
+		case 0x5: {
+			if ((opcode & 0xC0) == 0xC0) {
+				if (mode != 1) {					// Scc
+					return CPU_ILLEGAL_INSTRUCTION;
+				}
+
+				// DBcc
+				const uint32_t base = cpu->pc;
+				const uint32_t disp = signExtend(fetchWord(s), 2);
+
+				if (!testCondition(cpu, (opcode >> 8) & 0xF)) {
+					const uint16_t counter = (cpu->d[reg] - 1) & 0xFFFF;
+					cpu->d[reg] = (cpu->d[reg] & 0xFFFF0000) | counter;
+
+					if (counter != 0xFFFF) {
+						cpu->pc = base + disp;
+						s->cycles += 10;
+					}
+					else {
+						s->cycles += 14;
+					}
+				}
+				else {
+					s->cycles += 12;
+				}
+			}
+			else {
+				// ADDQ, SUBQ
+				const int size = SIZE_BITS((opcode >> 6) & 3);
+				const uint32_t data = reg2 ? reg2 : 8;
+				const int subtract = (opcode >> 8) & 1;
+
+				if (mode == 1) {
+					cpu->a[reg] += subtract ? -data : data;		// address registers: whole register, no flags
+					s->cycles += 8;
+				}
+				else {
+					const effAddr ea = decodeEA(s, mode, reg, size);
+					const uint32_t value = readEA(s, &ea, size);
+
+					s->cycles += (mode == 0) ? ((size == 4) ? 8 : 4) : (((size == 4) ? 12 : 8) + ea.cycles);
+
+					writeEA(s, &ea, size, subtract ? doSub(cpu, value, data, size, 1) : doAdd(cpu, value, data, size, 1));
+				}
+			}
+			break;
+		}
+
+		case 0x6: {
+			// BRA, BSR, Bcc
+			const uint32_t base = cpu->pc;
+			const int condition = (opcode >> 8) & 0xF;
+			uint32_t disp = signExtend(opcode, 1);
+
+			if ((opcode & 0xFF) == 0) {
+				disp = signExtend(fetchWord(s), 2);
+			}
+
+			if (condition == 1) {
+				cpu->a[7] -= 4;
+				memWrite(s, cpu->a[7], 4, cpu->pc);
+				cpu->pc = base + disp;
+				s->cycles += 18;
+			}
+			else if (testCondition(cpu, condition)) {
+				cpu->pc = base + disp;
+				s->cycles += 10;
+			}
+			else {
+				s->cycles += ((opcode & 0xFF) == 0) ? 12 : 8;
+			}
+			break;
+		}
+
+		case 0x7: {
+			// MOVEQ
+			if (opcode & 0x0100) {
+				return CPU_ILLEGAL_INSTRUCTION;
+			}
+			cpu->d[reg2] = signExtend(opcode, 1);
+			setLogicFlags(cpu, cpu->d[reg2], 4);
+			s->cycles += 4;
+			break;
+		}
+
+		case 0x8: case 0x9: case 0xB: case 0xC: case 0xD: {
+			const int opmode = (opcode >> 6) & 7;
+			const int group = opcode >> 12;
+
+			// ADDA, SUBA, CMPA
+			if (((opmode == 3) || (opmode == 7)) && ((group == 0x9) || (group == 0xB) || (group == 0xD))) {
+				const int size = (opmode == 7) ? 4 : 2;
+				const effAddr ea = decodeEA(s, mode, reg, size);
+				const uint32_t value = signExtend(readEA(s, &ea, size), size);
+
+				if (group == 0xB) {
+					s->cycles += 6 + ea.cycles;
+				}
+				else {
+					s->cycles += ((size == 2) || (mode <= 1) || (ea.kind == EA_IMMEDIATE) ? 8 : 6) + ea.cycles;
+				}
+
+				if (group == 0xD) {
+					cpu->a[reg2] += value;
+				}
+				else if (group == 0x9) {
+					cpu->a[reg2] -= value;
+				}
+				else {
+					doSub(cpu, cpu->a[reg2], value, 4, 0);
+				}
+				break;
+			}
+
+			// EXG
+			if ((group == 0xC) && ((opcode & 0x0130) == 0x0100) && (mode <= 1)) {
+				uint32_t * x = NULL;
+				uint32_t * y = NULL;
+
+				switch (opcode & 0xF8) {
+					case 0x40: x = &cpu->d[reg2]; y = &cpu->d[reg]; break;
+					case 0x48: x = &cpu->a[reg2]; y = &cpu->a[reg]; break;
+					case 0x88: x = &cpu->d[reg2]; y = &cpu->a[reg]; break;
+					default: return CPU_ILLEGAL_INSTRUCTION;
+				}
+
+				const uint32_t temp = *x;
+				*x = *y;
+				*y = temp;
+				s->cycles += 6;
+				break;
+			}
+
+			// MULU, MULS, DIVU, DIVS, ABCD, SBCD, ADDX, SUBX, CMPM
+			if ((opmode == 3) || (opmode == 7) || (((opmode & 4) != 0) && (mode <= 1) && (group != 0xB))
+					|| ((group == 0xB) && (opmode >= 4) && (mode == 1))) {
+				return CPU_ILLEGAL_INSTRUCTION;
+			}
+
+			const int size = SIZE_BITS(opmode & 3);
+			const int toMemory = (opmode & 4) != 0;
+			const effAddr ea = decodeEA(s, mode, reg, size);
+			const uint32_t value = readEA(s, &ea, size);
+			const uint32_t regValue = cpu->d[reg2];
+			const effAddr dregEA = { .kind = EA_DREG, .reg = reg2 };
+			const effAddr * dst = toMemory ? &ea : &dregEA;
+			const uint32_t dstValue = toMemory ? value : regValue;
+			const uint32_t srcValue = toMemory ? regValue : value;
+			uint32_t result;
+
+			if (toMemory && (mode == 0)) {		// EOR Dn,Dn
+				s->cycles += (size == 4) ? 8 : 4;
+			}
+			else if (toMemory) {
+				s->cycles += ((size == 4) ? 12 : 8) + ea.cycles;
+			}
+			else if ((size == 4) && (group != 0xB) && ((mode <= 1) || (ea.kind == EA_IMMEDIATE))) {
+				s->cycles += 8 + ea.cycles;
+			}
+			else {
+				s->cycles += ((size == 4) ? 6 : 4) + ea.cycles;
+			}
+
+			switch (group) {
+				case 0x8: result = dstValue | srcValue; setLogicFlags(cpu, result, size); writeEA(s, dst, size, result); break;
+				case 0xC: result = dstValue & srcValue; setLogicFlags(cpu, result, size); writeEA(s, dst, size, result); break;
+				case 0x9: writeEA(s, dst, size, doSub(cpu, dstValue, srcValue, size, 1)); break;
+				case 0xD: writeEA(s, dst, size, doAdd(cpu, dstValue, srcValue, size, 1)); break;
+				default:
+					if (toMemory) {		// EOR
+						result = dstValue ^ srcValue;
+						setLogicFlags(cpu, result, size);
+						writeEA(s, dst, size, result);
+					}
+					else {				// CMP
+						doSub(cpu, regValue, value, size, 0);
+					}
+					break;
+			}
+			break;
+		}
+
+		case 0xE:
+			execShift(s, opcode);
+			break;
+
+		default:
+			return CPU_ILLEGAL_INSTRUCTION;
+	}
+
+	cpu->cycles += state.cycles;
+
+	return state.error;
+}
+
+/*
+ * Calls subroutine at the given address, returns once it executes RTS
+ */
+int cpuCall(m68kCpu * cpu, uint32_t address, uint64_t maxInstructions) {
+	cpu->a[7] -= 4;
+	cpuWrite(cpu, cpu->a[7], 4, CALL_SENTINEL);
+	cpu->pc = address;
+
+	const uint64_t limit = cpu->instructions + maxInstructions;
+
+	while (cpu->pc != CALL_SENTINEL) {
+		if (cpu->instructions >= limit) {
+			return CPU_TIMEOUT;
+		}
+
+		const int result = step(cpu);
+
+		if (result != CPU_OK) {
+			return result;
+		}
+	}
+
+	return CPU_OK;
+}
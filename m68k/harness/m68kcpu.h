@@ -0,0 +1,43 @@
+
+/* ================================================================================= *
+ * Minimal M68000 CPU emulator for testing the M68K decompressors					 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stdint.h>
+
+/* Memory size, addresses wrap around the 24-bit bus */
+#define CPU_MEMORY_SIZE		0x1000000
+#define CPU_ADDRESS_MASK	0xFFFFFF
+
+/* Condition code register flags */
+#define CCR_C	0x01
+#define CCR_V	0x02
+#define CCR_Z	0x04
+#define CCR_N	0x08
+#define CCR_X	0x10
+
+/* Execution results */
+#define CPU_OK					0
+#define CPU_ILLEGAL_INSTRUCTION	1
+#define CPU_ADDRESS_ERROR		2
+#define CPU_TIMEOUT				3
+
+typedef struct {
+	uint32_t d[8];
+	uint32_t a[8];				// a[7] is the stack pointer
+	uint32_t pc;
+	uint16_t sr;
+	uint8_t * memory;			// CPU_MEMORY_SIZE bytes
+	uint64_t instructions;		// number of executed instructions
+	uint64_t cycles;			// number of elapsed clock cycles
+} m68kCpu;
+
+int cpuInit(m68kCpu * cpu);
+void cpuFree(m68kCpu * cpu);
+
+uint32_t cpuRead(m68kCpu * cpu, uint32_t address, int size);
+void cpuWrite(m68kCpu * cpu, uint32_t address, int size, uint32_t value);
+
+int cpuCall(m68kCpu * cpu, uint32_t address, uint64_t maxInstructions);
@@ -0,0 +1,543 @@
+
+/* ================================================================================= *
+ * Konami's LZSS variant 1 (LZKN1) compressor/decompressor							 *
+ * M68K decompressors testing harness												 *
+ *																					 *
+ * Assembles the M68K decompressors, runs them under the emulator and checks		 *
+ * the output against the C decompressor. Also compares the number of cycles		 *
+ * taken by the original and the fast decompressors.								 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lzkn.h"
+#include "m68kcpu.h"
+#include "m68kasm.h"
+#include "kondec_model.h"
+
+/* Various structures and macros to handle tests */
+typedef int (*testFunction)();
+
+typedef struct {
+	const char * name;
+	testFunction function;
+} testExecutorData;
+
+typedef struct {
+	const char * name;
+	size_t dataSize;
+	uint8_t * data;
+	lzkn1_strategy strategy;
+	size_t compressedSize;
+	uint8_t * compressed;
+	uint64_t originalCycles;	// cycles taken by the original decompressor
+} testEntry;
+
+/* Memory map of the emulated system */
+#define ORIGINAL_CODE_ADDR	0x001000
+#define SLICED_CODE_ADDR	0x002000
+#define FAST_CODE_ADDR		0x003000
+#define COMPRESSED_ADDR		0x100000
+#define OUTPUT_ADDR			0x200000
+#define STATE_ADDR			0x300000
+#define STACK_ADDR			0x400000
+
+#define GUARD_BYTE			0xA5
+#define GUARD_SIZE			0x100
+#define MAX_INSTRUCTIONS	100000000
+
+/* Source files, relative to the M68K sources directory */
+const char * asmDirectory = "m68k";
+
+static m68kCpu cpu;
+static asmProgram originalProgram;
+static asmProgram slicedProgram;
+static asmProgram fastProgram;
+
+static testEntry * testEntries = NULL;
+static size_t testEntriesCount = 0;
+
+
+/* ----------------------------------------------------------------------------- */
+/* Test data																	 */
+/* ----------------------------------------------------------------------------- */
+
+static uint64_t randomState = 0x4C5A4B4E31;
+
+static uint32_t nextRandom() {
+	randomState = randomState * 6364136223846793005ULL + 1442695040888963407ULL;
+	return randomState >> 33;
+}
+
+static void generateRuns(uint8_t * data, size_t size) {
+	for (size_t i = 0; i < size;) {
+		const uint8_t value = nextRandom();
+		for (size_t run = 1 + nextRandom() % 300; run && i < size; --run) {
+			data[i++] = value;
+		}
+	}
+}
+
+static void generateNoise(uint8_t * data, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		data[i] = nextRandom();
+	}
+}
+
+static void generateText(uint8_t * data, size_t size) {
+	static const char * const words[] = {
+		"the ", "konami ", "sprite ", "tiles ", "compression ", "art ", "level ", "of ", "and ", "data ", "\n"
+	};
+
+	for (size_t i = 0; i < size;) {
+		for (const char * word = words[nextRandom() % 11]; *word && i < size; ++word) {
+			data[i++] = *word;
+		}
+	}
+}
+
+static void generateTiles(uint8_t * data, size_t size) {
+	uint8_t tile[32];
+	generateNoise(tile, sizeof(tile));
+
+	for (size_t i = 0; i < size; ++i) {
+		if ((i % 32 == 0) && (nextRandom() % 4 == 0)) {
+			tile[nextRandom() % 32] = nextRandom();
+		}
+		data[i] = tile[i % 32] & 0x33;
+	}
+}
+
+/* Short literal groups between matches, gives many description fields without flags */
+static void generateMixed(uint8_t * data, size_t size) {
+	for (size_t i = 0; i < size;) {
+		for (size_t literals = 1 + nextRandom() % 12; literals && i < size; --literals) {
+			data[i++] = nextRandom();
+		}
+
+		const size_t distance = 1 + nextRandom() % 300;
+
+		for (size_t copy = 3 + nextRandom() % 6; copy && (i < size) && (i >= distance); --copy, ++i) {
+			data[i] = data[i - distance];
+		}
+	}
+}
+
+static void addTestEntry(const char * name, void (*generator)(uint8_t *, size_t), size_t size) {
+	static const lzkn1_strategy strategies[] = {
+		LZKN1_STRATEGY_GREEDY, LZKN1_STRATEGY_OPTIMAL, LZKN1_STRATEGY_MODE2, LZKN1_STRATEGY_RAW
+	};
+
+	uint8_t * data = malloc(size ? size : 1);
+	generator(data, size);
+
+	for (int i = 0; i < sizeof(strategies) / sizeof(strategies[0]); ++i) {
+		testEntry * entry;
+
+		testEntries = realloc(testEntries, (testEntriesCount + 1) * sizeof(testEntry));
+		entry = &testEntries[testEntriesCount++];
+
+		entry->name = name;
+		entry->dataSize = size;
+		entry->data = data;
+		entry->strategy = strategies[i];
+		entry->compressed = malloc(LZKN1_COMPRESS_BOUND(size));
+
+		if (lzkn1_compress_strategy(strategies[i], data, size, entry->compressed, LZKN1_COMPRESS_BOUND(size), &entry->compressedSize) != 0) {
+			entry->compressedSize = 0;
+		}
+	}
+}
+
+static void generateTestEntries() {
+	addTestEntry("noise", generateNoise, 0);
+	addTestEntry("noise", generateNoise, 1);
+	addTestEntry("noise", generateNoise, 72);
+	addTestEntry("noise", generateNoise, 3000);
+	addTestEntry("runs", generateRuns, 4096);
+	addTestEntry("runs", generateRuns, 0xFFFF);
+	addTestEntry("text", generateText, 20000);
+	addTestEntry("tiles", generateTiles, 16384);
+	addTestEntry("mixed", generateMixed, 30000);
+}
+
+
+/* ----------------------------------------------------------------------------- */
+/* Emulator helpers																 */
+/* ----------------------------------------------------------------------------- */
+
+static int assemble(asmProgram * program, const char * fileName, uint32_t origin) {
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", asmDirectory, fileName);
+
+	if (asmAssembleFile(program, path, cpu.memory, origin) != 0) {
+		printf("ERROR: Couldn't assemble %s: %s\n", path, program->error);
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint32_t symbolAddress(const asmProgram * program, const char * name) {
+	uint32_t value = 0;
+
+	if (asmFindSymbol(program, name, &value) != 0) {
+		printf("ERROR: Symbol \"%s\" not found\n", name);
+		exit(-1);
+	}
+
+	return value;
+}
+
+/* Loads compressed data and fills output buffer with guard bytes */
+static void loadTestEntry(const testEntry * entry, uint32_t compressedAddr, uint32_t outputAddr) {
+	memcpy(&cpu.memory[compressedAddr], entry->compressed, entry->compressedSize);
+	memset(&cpu.memory[outputAddr], GUARD_BYTE, entry->dataSize + GUARD_SIZE);
+}
+
+/* Checks decompressed data and guard bytes after it */
+static int checkOutput(const testEntry * entry, uint32_t outputAddr) {
+	if (memcmp(&cpu.memory[outputAddr], entry->data, entry->dataSize) != 0) {
+		printf("FAIL: Decompressed data doesn't match\n");
+		return -1;
+	}
+
+	for (size_t i = 0; i < GUARD_SIZE; ++i) {
+		if (cpu.memory[outputAddr + entry->dataSize + i] != GUARD_BYTE) {
+			printf("FAIL: Decompressor wrote past the end of the output\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void resetRegisters() {
+	for (int i = 0; i < 8; ++i) {
+		cpu.d[i] = 0xDEAD0000 | i;
+		cpu.a[i] = 0xBEEF0000 | i;
+	}
+
+	cpu.a[7] = STACK_ADDR;
+}
+
+static const char * cpuResultMessage(int result) {
+	static const char * const messages[] = { "ok", "illegal instruction", "address error", "timeout" };
+	return messages[result];
+}
+
+
+/* ----------------------------------------------------------------------------- */
+/* Tests																		 */
+/* ----------------------------------------------------------------------------- */
+
+int executeOriginalDecompressorTests() {
+	const uint32_t entryPoint = symbolAddress(&originalProgram, "KonDec");
+
+	for (size_t testId = 0; testId < testEntriesCount; ++testId) {
+		testEntry * entry = &testEntries[testId];
+
+		printf("TEST %s, %ld bytes, %s strategy... ", entry->name, entry->dataSize, lzkn1_strategy_name(entry->strategy));
+
+		loadTestEntry(entry, COMPRESSED_ADDR, OUTPUT_ADDR);
+		resetRegisters();
+		cpu.a[5] = COMPRESSED_ADDR;
+		cpu.a[6] = OUTPUT_ADDR;
+
+		const uint64_t startCycles = cpu.cycles;
+		const int result = cpuCall(&cpu, entryPoint, MAX_INSTRUCTIONS);
+
+		entry->originalCycles = cpu.cycles - startCycles;
+
+		if (result != CPU_OK) {
+			printf("FAIL: Emulation stopped at $%06X (%s)\n", cpu.pc, cpuResultMessage(result));
+			return -1;
+		}
+
+		if (checkOutput(entry, OUTPUT_ADDR) != 0) {
+			return -1;
+		}
+
+		printf("PASS\n");
+	}
+
+	return 0;
+}
+
+int executeSlicedDecompressorTests() {
+	const uint32_t initEntryPoint = symbolAddress(&slicedProgram, "KonDecSliced_Init");
+	const uint32_t resumeEntryPoint = symbolAddress(&slicedProgram, "KonDecSliced_Resume");
+	const uint16_t budgets[] = { 1, 7, 64, 333, 0xFFFF };
+
+	for (size_t testId = 0; testId < testEntriesCount; ++testId) {
+		const testEntry * entry = &testEntries[testId];
+
+		for (int i = 0; i < sizeof(budgets) / sizeof(budgets[0]); ++i) {
+			const uint16_t budget = budgets[i];
+			size_t slices = 0;
+			konDecSlicedState model;
+			uint8_t * modelOutput = malloc(entry->dataSize + 1);
+
+			printf("TEST %s, %ld bytes, %s strategy, %d bytes per slice... ", entry->name, entry->dataSize, lzkn1_strategy_name(entry->strategy), budget);
+
+			loadTestEntry(entry, COMPRESSED_ADDR, OUTPUT_ADDR);
+			resetRegisters();
+			cpu.a[1] = STATE_ADDR;
+			cpu.a[5] = COMPRESSED_ADDR;
+			cpu.a[6] = OUTPUT_ADDR;
+
+			int result = cpuCall(&cpu, initEntryPoint, MAX_INSTRUCTIONS);
+			konDecSlicedInit(&model);
+
+			for (int finished = 0; !finished && result == CPU_OK; ) {
+				resetRegisters();
+				cpu.a[1] = STATE_ADDR;
+				cpu.d[0] = budget;
+
+				result = cpuCall(&cpu, resumeEntryPoint, MAX_INSTRUCTIONS);
+
+				if (result != CPU_OK) {
+					break;
+				}
+
+				const int modelResult = konDecSlicedResume(&model, entry->compressed, entry->compressedSize, modelOutput, entry->dataSize, budget);
+				const uint32_t state = STATE_ADDR;
+
+				// Compare the saved state and the result against the model
+				if ((modelResult == KONDEC_OVERFLOW)
+					|| (cpu.d[0] != (modelResult == KONDEC_FINISHED ? 0 : 0xFFFFFFFF))
+					|| (cpuRead(&cpu, state + 0, 4) != COMPRESSED_ADDR + model.src)
+					|| (cpuRead(&cpu, state + 4, 4) != OUTPUT_ADDR + model.dst)
+					|| (cpuRead(&cpu, state + 8, 2) != model.desc)
+					|| ((int16_t)cpuRead(&cpu, state + 10, 2) != model.bits)
+					|| (cpuRead(&cpu, state + 12, 2) != model.copyLen)
+					|| ((int16_t)cpuRead(&cpu, state + 14, 2) != model.copyDisp)) {
+					printf("FAIL: State after slice %ld doesn't match the model\n", slices);
+					free(modelOutput);
+					return -1;
+				}
+
+				// Registers outside of "USES" must be preserved
+				if ((cpu.d[3] != 0xDEAD0003) || (cpu.d[4] != 0xDEAD0004) || (cpu.d[5] != 0xDEAD0005)
+					|| (cpu.a[0] != 0xBEEF0000) || (cpu.a[1] != STATE_ADDR) || (cpu.a[2] != 0xBEEF0002)
+					|| (cpu.a[3] != 0xBEEF0003) || (cpu.a[4] != 0xBEEF0004) || (cpu.a[7] != STACK_ADDR)) {
+					printf("FAIL: Slice %ld trashed registers\n", slices);
+					free(modelOutput);
+					return -1;
+				}
+
+				finished = (modelResult == KONDEC_FINISHED);
+
+				if (++slices > entry->dataSize / budget + 2) {
+					printf("FAIL: Decompression takes too many slices\n");
+					free(modelOutput);
+					return -1;
+				}
+			}
+
+			// The model should decompress the data as well, so its state is worth comparing against
+			const int modelOutputMismatch = (model.dst != entry->dataSize) || (memcmp(modelOutput, entry->data, entry->dataSize) != 0);
+
+			free(modelOutput);
+
+			if (result != CPU_OK) {
+				printf("FAIL: Emulation stopped at $%06X (%s)\n", cpu.pc, cpuResultMessage(result));
+				return -1;
+			}
+
+			if (modelOutputMismatch) {
+				printf("FAIL: Reference model output doesn't match the source data\n");
+				return -1;
+			}
+
+			if (checkOutput(entry, OUTPUT_ADDR) != 0) {
+				return -1;
+			}
+
+			printf("PASS (%ld slices)\n", slices);
+		}
+	}
+
+	return 0;
+}
+
+int executeFastDecompressorTests() {
+	const uint32_t entryPoint = symbolAddress(&fastProgram, "KonDecFast");
+	uint64_t totalOriginalCycles = 0;
+	uint64_t totalFastCycles = 0;
+
+	for (size_t testId = 0; testId < testEntriesCount; ++testId) {
+		const testEntry * entry = &testEntries[testId];
+
+		printf("TEST %s, %ld bytes, %s strategy... ", entry->name, entry->dataSize, lzkn1_strategy_name(entry->strategy));
+
+		loadTestEntry(entry, COMPRESSED_ADDR, OUTPUT_ADDR);
+		resetRegisters();
+		cpu.a[5] = COMPRESSED_ADDR;
+		cpu.a[6] = OUTPUT_ADDR;
+
+		const uint64_t startCycles = cpu.cycles;
+		const int result = cpuCall(&cpu, entryPoint, MAX_INSTRUCTIONS);
+		const uint64_t fastCycles = cpu.cycles - startCycles;
+
+		if (result != CPU_OK) {
+			printf("FAIL: Emulation stopped at $%06X (%s)\n", cpu.pc, cpuResultMessage(result));
+			return -1;
+		}
+
+		if (checkOutput(entry, OUTPUT_ADDR) != 0) {
+			return -1;
+		}
+
+		// Registers outside of "USES" must be preserved
+		if ((cpu.d[3] != 0xDEAD0003) || (cpu.d[4] != 0xDEAD0004) || (cpu.d[5] != 0xDEAD0005)
+			|| (cpu.d[6] != 0xDEAD0006) || (cpu.d[7] != 0xDEAD0007) || (cpu.a[1] != 0xBEEF0001) || (cpu.a[2] != 0xBEEF0002)
+			|| (cpu.a[3] != 0xBEEF0003) || (cpu.a[4] != 0xBEEF0004) || (cpu.a[7] != STACK_ADDR)) {
+			printf("FAIL: Decompressor trashed registers\n");
+			return -1;
+		}
+
+		totalOriginalCycles += entry->originalCycles;
+		totalFastCycles += fastCycles;
+
+		printf("PASS (%llu cycles, original: %llu, %.1f%% less)\n", (unsigned long long)fastCycles, (unsigned long long)entry->originalCycles,
+			entry->originalCycles ? 100.0 - 100.0 * fastCycles / entry->originalCycles : 0.0);
+	}
+
+	printf("Total: %llu cycles, original: %llu, %.1f%% less (%.2fx speed-up)\n", (unsigned long long)totalFastCycles, (unsigned long long)totalOriginalCycles,
+		100.0 - 100.0 * totalFastCycles / totalOriginalCycles, (double)totalOriginalCycles / totalFastCycles);
+
+	if (totalFastCycles >= totalOriginalCycles) {
+		printf("FAIL: Fast decompressor isn't faster than the original one\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int executeFastDecompressorAlignmentTests() {
+	const uint32_t entryPoint = symbolAddress(&fastProgram, "KonDecFast");
+
+	// Longword copies depend on the input and output parity, so try every combination
+	const struct { uint32_t compressedAddr, outputAddr; } bases[] = {
+		{ COMPRESSED_ADDR + 1, OUTPUT_ADDR },
+		{ COMPRESSED_ADDR, OUTPUT_ADDR + 1 },
+		{ COMPRESSED_ADDR + 1, OUTPUT_ADDR + 1 }
+	};
+
+	for (size_t testId = 0; testId < testEntriesCount; ++testId) {
+		const testEntry * entry = &testEntries[testId];
+
+		// Whole stream in a single slice, as the model's output doesn't depend on slicing
+		konDecSlicedState model;
+		uint8_t * modelOutput = malloc(entry->dataSize + 1);
+		int modelResult;
+
+		konDecSlicedInit(&model);
+
+		do {
+			modelResult = konDecSlicedResume(&model, entry->compressed, entry->compressedSize, modelOutput, entry->dataSize, 0xFFFF);
+		} while (modelResult == KONDEC_SUSPENDED);
+
+		for (int i = 0; i < sizeof(bases) / sizeof(bases[0]); ++i) {
+			const uint32_t compressedAddr = bases[i].compressedAddr;
+			const uint32_t outputAddr = bases[i].outputAddr;
+
+			printf("TEST %s, %ld bytes, %s strategy, input at $%06X, output at $%06X... ", entry->name, entry->dataSize,
+				lzkn1_strategy_name(entry->strategy), compressedAddr, outputAddr);
+
+			loadTestEntry(entry, compressedAddr, outputAddr);
+			resetRegisters();
+			cpu.a[5] = compressedAddr;
+			cpu.a[6] = outputAddr;
+
+			const int result = cpuCall(&cpu, entryPoint, MAX_INSTRUCTIONS);
+
+			if (result != CPU_OK) {
+				printf("FAIL: Emulation stopped at $%06X (%s)\n", cpu.pc, cpuResultMessage(result));
+				free(modelOutput);
+				return -1;
+			}
+
+			if ((modelResult != KONDEC_FINISHED) || (model.dst != entry->dataSize)
+				|| (memcmp(&cpu.memory[outputAddr], modelOutput, entry->dataSize) != 0)) {
+				printf("FAIL: Decompressed data doesn't match the reference model\n");
+				free(modelOutput);
+				return -1;
+			}
+
+			if (checkOutput(entry, outputAddr) != 0) {
+				free(modelOutput);
+				return -1;
+			}
+
+			if ((cpu.a[5] != compressedAddr + entry->compressedSize) || (cpu.a[6] != outputAddr + entry->dataSize)) {
+				printf("FAIL: Decompressor stopped at input $%06X, output $%06X\n", cpu.a[5], cpu.a[6]);
+				free(modelOutput);
+				return -1;
+			}
+
+			printf("PASS\n");
+		}
+
+		free(modelOutput);
+	}
+
+	return 0;
+}
+
+/* Define test executors */
+const testExecutorData testsExecutorsSequence[] = {
+	{ .name = "Original decompressor tests", .function = executeOriginalDecompressorTests },
+	{ .name = "Time-sliced decompressor tests", .function = executeSlicedDecompressorTests },
+	{ .name = "Fast decompressor tests", .function = executeFastDecompressorTests },
+	{ .name = "Fast decompressor alignment tests", .function = executeFastDecompressorAlignmentTests }
+};
+
+int main(int argc, char ** argv) {
+	int result = 0;
+
+	if (argc > 1) {
+		asmDirectory = argv[1];
+	}
+
+	if (cpuInit(&cpu) != 0) {
+		printf("ERROR: Couldn't allocate emulator memory\n");
+		return -1;
+	}
+
+	if ((assemble(&originalProgram, "decompress.asm", ORIGINAL_CODE_ADDR) != 0)
+		|| (assemble(&slicedProgram, "decompress_sliced.asm", SLICED_CODE_ADDR) != 0)
+		|| (assemble(&fastProgram, "decompress_fast.asm", FAST_CODE_ADDR) != 0)) {
+		return -1;
+	}
+
+	generateTestEntries();
+
+	for (size_t i = 0; i < testEntriesCount; ++i) {
+		if (testEntries[i].compressedSize == 0) {
+			printf("ERROR: Couldn't compress test data\n");
+			return -1;
+		}
+	}
+
+	for (int i = 0; (result == 0) && (i < sizeof(testsExecutorsSequence) / sizeof(testsExecutorsSequence[0])); ++i) {
+		const testExecutorData * testExecutor = &testsExecutorsSequence[i];
+
+		printf("Running %s...\n", testExecutor->name);
+
+		result = (*testExecutor->function)();
+	}
+
+	asmFree(&originalProgram);
+	asmFree(&slicedProgram);
+	asmFree(&fastProgram);
+	cpuFree(&cpu);
+
+	return result;
+}
@@ -7,10 +7,14 @@
  * ================================================================================= */
 
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 /* Include compress/decompress functions */
 #include "lzkn.h"
@@ -19,27 +23,46 @@
 #define FAIL_IF_NONZERO(expr)	if ((expr) != 0) return -1;
 #define FAIL_IF_ZERO(expr)		if (!(expr)) return -1;
 
+/* Exit status for failed compression/decompression ("lz_error" codes don't fit in 8 bits) */
+#define EXIT_CODEC_FAILED		5
+
 /* Helper types */
 typedef enum { COMPRESS, DECOMPRESS, RECOMPRESS } operationMode;
 
 /* Program usage */
 const char * usageMessageStr = 
-	"Konami's LZSS variant 1 (LZKN1) compressor/decompressor v.1.5.1\n"
+	"Konami's LZSS variant 1 (LZKN1) compressor/decompressor v.1.7.0\n"
 	"(c) 2020, Vladikcomper\n"
 	"\n"
 	"USAGE:\n"
-	"	lzkn [-c|-d|-r] input_path [output_path]\n"
+	"	lzkn [-c|-d|-r] [--max|--time-budget <ms>] input_path [output_path]\n"
+	"	lzkn --verify [-j <threads>] [--manifest <path>] [[--expect <adler32>] input_path]...\n"
 	"	\n"
-	"	The first optional argument, if present, selects operation mode:\n"
+	"	The optional mode flag, if present, must precede <input_path>:\n"
 	"		-c	Compress <input_path>;\n"
 	"		-d	Decompress <input_path>;\n"
 	"		-r	Recompress <input_path> (decompress and compress again).\n\n"
 	"	If flag is ommited, compression mode is assumed."
 	"	\n"
+	"	Additional options (may appear anywhere):\n"
+	"		--max	Try all parse strategies in parallel and keep the smallest result.\n"
+	"		--time-budget <ms>\n"
+	"			Improve compression until the time budget (in milliseconds) runs out.\n"
+	"	\n"
 	"	If [output_path] is not specified, it's set as follows:\n"
 	"		= <input_path> + \".lzkn1\" extension if in compression mode;\n"
 	"		= <input_path> + \".unc\" extension if in decompression mode;\n"
-	"		= <input_path> (w/o changes) in recompression mode.\n";
+	"		= <input_path> (w/o changes) in recompression mode.\n"
+	"	\n"
+	"	Verification mode (--verify) decodes every <input_path> without writing\n"
+	"	anything, reports its size and Adler-32 checksum and fails if any stream\n"
+	"	is invalid. Options:\n"
+	"		-j <threads>	Number of threads (default: number of CPUs);\n"
+	"		--expect <adler32>\n"
+	"			Also fail if the checksum of the next <input_path> differs;\n"
+	"		--manifest <path>\n"
+	"			Also verify the files listed in <path>, one \"path<TAB>adler32\"\n"
+	"			line per file, against their checksums.\n";
 
 /*
  * Prints program usage
@@ -105,55 +128,422 @@ int writeFile(const char * path, uint8_t * buffer, size_t bufferSize) {
 	return 0;
 }
 
+/* Verification job of a single file */
+typedef struct {
+	const char * path;
+	int hasExpectedChecksum;
+	uint32_t expectedChecksum;
+	int readResult;
+	lz_error result;
+	size_t decompressedSize;
+	uint32_t checksum;
+} verifyJob;
+
+/* Hands out verification jobs to threads */
+typedef struct {
+	pthread_mutex_t mutex;
+	verifyJob * jobs;
+	size_t numJobs;
+	size_t maxJobs;
+	size_t nextJob;
+	char ** manifests;			// manifest contents, which job paths may point into
+	size_t numManifests;
+} verifyRunner;
+
 /*
- * Parses command line arguments
+ * Parses a hexadecimal Adler-32 checksum
  */
-int parseAgrs(int argc, char ** argv, operationMode * mode, char ** inputPathPtr, char ** outputPathPtr) {
+int parseChecksum(const char * str, uint32_t * checksum) {
+	char * valueEnd = NULL;
+	const unsigned long value = strtoul(str, &valueEnd, 16);
 
-	// Handle "too few" arguments error
-	if (argc < 2) {
+	if ((valueEnd == str) || (*valueEnd != 0x00) || (value > UINT32_MAX)) {
+		return -1;
+	}
+
+	*checksum = value;
+
+	return 0;
+}
+
+/*
+ * Adds a file to the runner, growing the job list if necessary
+ */
+int addVerifyJob(verifyRunner * runner, const char * path, const uint32_t * expectedChecksum) {
+	if (runner->numJobs == runner->maxJobs) {
+		const size_t maxJobs = runner->maxJobs ? runner->maxJobs * 2 : 16;
+		verifyJob * jobs;
+
+		FAIL_IF_ZERO(jobs = realloc(runner->jobs, maxJobs * sizeof(verifyJob)));
+		runner->jobs = jobs;
+		runner->maxJobs = maxJobs;
+	}
+
+	runner->jobs[runner->numJobs++] = (verifyJob){
+		.path = path,
+		.hasExpectedChecksum = (expectedChecksum != NULL),
+		.expectedChecksum = expectedChecksum ? *expectedChecksum : 0
+	};
+
+	return 0;
+}
+
+/*
+ * Adds every file listed in the manifest, one "path<TAB>adler32" line per file
+ * 
+ * Empty lines and lines starting with '#' are skipped. Returns the number of the
+ * first malformed line, -1 if out of memory or -2 if the manifest can't be read.
+ */
+int readManifest(verifyRunner * runner, const char * path) {
+	uint8_t * buff = NULL;
+	size_t buffSize;
+
+	if (readFile(path, &buff, &buffSize) != 0) {
+		free(buff);
+		return -2;
+	}
+
+	char * text = realloc(buff, buffSize + 1);
+
+	if (!text) {
+		free(buff);
+		return -1;
+	}
+
+	text[buffSize] = 0x00;
+	runner->manifests[runner->numManifests++] = text;
+
+	int lineNumber = 0;
+
+	for (char * line = text; line != NULL; ) {
+		char * nextLine = strchr(line, '\n');
+		size_t lineSize = nextLine ? (size_t)(nextLine - line) : strlen(line);
+
+		if (nextLine) {
+			*nextLine++ = 0x00;
+		}
+		if ((lineSize > 0) && (line[lineSize - 1] == '\r')) {
+			line[--lineSize] = 0x00;
+		}
+		++lineNumber;
+
+		if ((lineSize > 0) && (line[0] != '#')) {
+			char * separator = strrchr(line, '\t');
+			uint32_t expectedChecksum;
+
+			if ((separator == NULL) || (separator == line)) {
+				return lineNumber;
+			}
+
+			*separator = 0x00;
+
+			if (parseChecksum(separator + 1, &expectedChecksum) != 0) {
+				return lineNumber;
+			}
+
+			FAIL_IF_NONZERO(addVerifyJob(runner, line, &expectedChecksum));
+		}
+
+		line = nextLine;
+	}
+
+	return 0;
+}
+
+/*
+ * Verification thread: takes files from the runner until none are left
+ */
+void * runVerifyThread(void * arg) {
+	verifyRunner * runner = arg;
+
+	for (;;) {
+		pthread_mutex_lock(&runner->mutex);
+		const size_t jobId = runner->nextJob++;
+		pthread_mutex_unlock(&runner->mutex);
+
+		if (jobId >= runner->numJobs) {
+			break;
+		}
+
+		verifyJob * job = &runner->jobs[jobId];
+		uint8_t * inBuff = NULL;
+		size_t inBuffSize;
+
+		job->readResult = readFile(job->path, &inBuff, &inBuffSize);
+
+		if (job->readResult == 0) {
+			job->result = lzkn1_verify(inBuff, inBuffSize, job->hasExpectedChecksum ? &job->expectedChecksum : NULL, &job->decompressedSize, &job->checksum);
+		}
+
+		free(inBuff);
+	}
+
+	return NULL;
+}
+
+/*
+ * Parses verification mode arguments into the runner's job list
+ */
+int parseVerifyArgs(int argc, char ** argv, verifyRunner * runner, long * numThreads) {
+
+	uint32_t expectedChecksum;
+	int hasExpectedChecksum = 0;		// "--expect" applies to the next input path
+
+	for (int i = 1; i < argc; ++i) {
+		const char * arg = argv[i];
+
+		if (strcmp(arg, "--verify") == 0) {
+			continue;
+		}
+		else if (strcmp(arg, "-j") == 0) {
+			char * valueEnd = NULL;
+
+			if (i + 1 < argc) {
+				*numThreads = strtol(argv[++i], &valueEnd, 10);
+			}
+
+			if ((valueEnd == NULL) || (*valueEnd != 0x00) || (*numThreads < 0)) {
+				fprintf(stderr, "ERROR: -j expects a number of threads.\n");
+				return 3;
+			}
+		}
+		else if (strcmp(arg, "--expect") == 0) {
+			if (hasExpectedChecksum || (i + 1 >= argc) || (parseChecksum(argv[++i], &expectedChecksum) != 0)) {
+				fprintf(stderr, "ERROR: --expect expects a hexadecimal checksum followed by an input path.\n");
+				return 3;
+			}
+			hasExpectedChecksum = 1;
+		}
+		else if (strcmp(arg, "--manifest") == 0) {
+			if (i + 1 >= argc) {
+				fprintf(stderr, "ERROR: --manifest expects a path.\n");
+				return 3;
+			}
+
+			const char * manifestPath = argv[++i];
+			const int manifestResult = readManifest(runner, manifestPath);
+
+			if (manifestResult == -2) {
+				fprintf(stderr, "ERROR: Unable to read the manifest file \"%s\".\n", manifestPath);
+				return 3;
+			}
+			FAIL_IF_NONZERO(manifestResult == -1);
+
+			if (manifestResult != 0) {
+				fprintf(stderr, "ERROR: %s:%d: expected \"path<TAB>adler32\".\n", manifestPath, manifestResult);
+				return 3;
+			}
+		}
+		else if (arg[0] == '-') {
+			fprintf(stderr, "ERROR: Unknown option \"%s\" in verification mode.\n", arg);
+			return 3;
+		}
+		else {
+			FAIL_IF_NONZERO(addVerifyJob(runner, arg, hasExpectedChecksum ? &expectedChecksum : NULL));
+			hasExpectedChecksum = 0;
+		}
+	}
+
+	if (hasExpectedChecksum) {
+		fprintf(stderr, "ERROR: --expect expects a hexadecimal checksum followed by an input path.\n");
+		return 3;
+	}
+
+	if (runner->numJobs == 0) {
 		printUsage();
 		fprintf(stderr, "ERROR: Too few arguments.\n");
-
 		return 1;
 	}
 
-	// Handle "too many" arguments warning
-	else if (argc > 4) {
-		fprintf(stderr, "WARNING: Unexpected arguments found.\n");
+	return 0;
+}
+
+/*
+ * Verifies all jobs of the runner in parallel and reports the results
+ */
+int runVerifyJobs(verifyRunner * runner, long numThreads) {
+
+	if (numThreads == 0) {
+		numThreads = lzkn1_cpu_count();
+	}
+	if ((numThreads < 1) || ((size_t)numThreads > runner->numJobs)) {
+		numThreads = (numThreads < 1) ? 1 : (long)runner->numJobs;
+	}
+
+	pthread_t * threads;
+	struct timespec startTime, endTime;
+
+	FAIL_IF_ZERO(threads = malloc(numThreads * sizeof(pthread_t)));
+
+	pthread_mutex_init(&runner->mutex, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+	int numStarted = 0;
+
+	for (; numStarted < numThreads; ++numStarted) {
+		if (pthread_create(&threads[numStarted], NULL, runVerifyThread, runner) != 0) {
+			break;
+		}
+	}
+
+	if (numStarted == 0) {
+		runVerifyThread(runner);
+	}
+	for (int i = 0; i < numStarted; ++i) {
+		pthread_join(threads[i], NULL);
 	}
 
-	// Check if the first argument specifies an operation mode flag ...
-	if (argv[1][0] == '-') {
-		const char * modeFlag = argv[1];
-		int modeFlagSet = 0;
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	pthread_mutex_destroy(&runner->mutex);
+	free(threads);
+
+	// Report in the order the files were given
+	size_t numFailures = 0;
+	size_t numBytes = 0;
 
-		*inputPathPtr = argv[2];						// the second argument specifies <input_path> then
-		*outputPathPtr = (argc > 3) ? argv[3] : NULL;	// the third argument (if present) specifies <output_path>
+	for (size_t i = 0; i < runner->numJobs; ++i) {
+		const verifyJob * job = &runner->jobs[i];
 
-		if (modeFlag[1] == 'c') {
-			*mode = COMPRESS;
-			modeFlagSet = 1;
+		if (job->readResult != 0) {
+			fprintf(stderr, "FAILED: %s: unable to read the file (code %d)\n", job->path, job->readResult);
+			++numFailures;
 		}
-		else if (modeFlag[1] == 'd') {
-			*mode = DECOMPRESS;
-			modeFlagSet = 1;
+		else if (job->result != 0) {
+			if (job->result == LZ_CHECKSUM_MISMATCH) {
+				fprintf(stderr, "FAILED: %s: checksum %08X, expected %08X\n", job->path, job->checksum, job->expectedChecksum);
+			}
+			else {
+				fprintf(stderr, "FAILED: %s: invalid stream (code %X)\n", job->path, job->result);
+			}
+			++numFailures;
 		}
-		else if (modeFlag[1] == 'r') {
-			*mode = RECOMPRESS;
-			modeFlagSet = 1;
+		else {
+			printf("OK: %s (%ld bytes, checksum %08X)\n", job->path, (long)job->decompressedSize, job->checksum);
+			numBytes += job->decompressedSize;
 		}
-		
-		if (!modeFlagSet || modeFlag[2] != 0x00) {
-			fprintf(stderr, "ERROR: Unknown mode flag \"%s\". Only -c, -d and -r flags are supported.\n", modeFlag);
-			return 2;
+	}
+
+	const double elapsed = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+	printf("Verified %ld files (%ld failed), %ld bytes in %.3f s, %ld threads\n",
+		(long)runner->numJobs, (long)numFailures, (long)numBytes, elapsed, numThreads);
+
+	return numFailures ? 4 : 0;
+}
+
+/*
+ * Verification mode: decodes the given files in parallel without writing any output
+ */
+int runVerification(int argc, char ** argv) {
+
+	long numThreads = 0;
+	verifyRunner runner = { .jobs = NULL, .numJobs = 0, .maxJobs = 0, .nextJob = 0, .manifests = NULL, .numManifests = 0 };
+
+	// Every manifest takes at least two arguments, so "argc" entries are always enough
+	FAIL_IF_ZERO(runner.manifests = malloc(argc * sizeof(char *)));
+
+	int result = parseVerifyArgs(argc, argv, &runner, &numThreads);
+
+	if (result == 0) {
+		result = runVerifyJobs(&runner, numThreads);
+	}
+	if (result < 0) {
+		fprintf(stderr, "ERROR: Unable to allocate memory.\n");
+	}
+
+	for (size_t i = 0; i < runner.numManifests; ++i) {
+		free(runner.manifests[i]);
+	}
+	free(runner.manifests);
+	free(runner.jobs);
+
+	return result;
+}
+
+/*
+ * Parses command line arguments
+ */
+int parseAgrs(int argc, char ** argv, operationMode * mode, int * maxMode, long * timeBudget, char ** inputPathPtr, char ** outputPathPtr) {
+
+	int modeFlagSet = 0;
+	int numPaths = 0;
+
+	*inputPathPtr = NULL;
+	*outputPathPtr = NULL;
+
+	for (int i = 1; i < argc; ++i) {
+		const char * arg = argv[i];
+
+		// Long options may appear anywhere
+		if (strcmp(arg, "--max") == 0) {
+			*maxMode = 1;
+		}
+		else if (strcmp(arg, "--time-budget") == 0) {
+			char * valueEnd = NULL;
+
+			if (i + 1 < argc) {
+				*timeBudget = strtol(argv[++i], &valueEnd, 10);
+			}
+
+			// Budget is passed on as "uint32_t", so reject values which wouldn't fit
+			if ((valueEnd == NULL) || (*valueEnd != 0x00) || (*timeBudget < 0) || ((unsigned long)*timeBudget > UINT32_MAX)) {
+				fprintf(stderr, "ERROR: --time-budget expects a number of milliseconds (0..%lu).\n", (unsigned long)UINT32_MAX);
+				return 3;
+			}
+		}
+
+		// Operation mode flag is accepted once, anywhere before <input_path>
+		else if (!modeFlagSet && (numPaths == 0) && (arg[0] == '-')) {
+			if (arg[1] == 'c') {
+				*mode = COMPRESS;
+				modeFlagSet = 1;
+			}
+			else if (arg[1] == 'd') {
+				*mode = DECOMPRESS;
+				modeFlagSet = 1;
+			}
+			else if (arg[1] == 'r') {
+				*mode = RECOMPRESS;
+				modeFlagSet = 1;
+			}
+			
+			if (!modeFlagSet || arg[2] != 0x00) {
+				fprintf(stderr, "ERROR: Unknown mode flag \"%s\". Only -c, -d and -r flags are supported.\n", arg);
+				return 2;
+			}
+		}
+
+		// Otherwise, the argument specifies <input_path> or <output_path>
+		else if (numPaths == 0) {
+			*inputPathPtr = argv[i];
+			++numPaths;
+		}
+		else if (numPaths == 1) {
+			*outputPathPtr = argv[i];
+			++numPaths;
+		}
+
+		// Handle "too many" arguments warning
+		else {
+			fprintf(stderr, "WARNING: Unexpected arguments found.\n");
 		}
 	}
 
-	// If the first argument is not an operation mode flag ...
-	else {
-		*inputPathPtr = argv[1];						// the fist argument specifies <input_path> then
-		*outputPathPtr = (argc > 2) ? argv[2] : NULL;	// the third argument (if present) specifies <output_path>
+	// Handle "too few" arguments error
+	if (*inputPathPtr == NULL) {
+		printUsage();
+		fprintf(stderr, "ERROR: Too few arguments.\n");
+
+		return 1;
+	}
+
+	if (*maxMode && (*timeBudget >= 0)) {
+		fprintf(stderr, "ERROR: --max and --time-budget can't be used together.\n");
+		return 3;
+	}
+
+	if ((*maxMode || (*timeBudget >= 0)) && (*mode == DECOMPRESS)) {
+		fprintf(stderr, "WARNING: --max and --time-budget have no effect in decompression mode.\n");
 	}
 
 	return 0;
@@ -164,13 +554,22 @@ int parseAgrs(int argc, char ** argv, operationMode * mode, char ** inputPathPtr
  * The main function
  */
 int main(int argc, char ** argv) {
+
+	// Verification mode takes any number of inputs, so it has its own arguments
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--verify") == 0) {
+			return runVerification(argc, argv);
+		}
+	}
 		
 	// Parse input arguments
 	char * inputPath;
 	char * outputPath;
 	operationMode mode = COMPRESS;
+	int maxMode = 0;
+	long timeBudget = -1;
 
-	int argParseResult = parseAgrs(argc, argv, &mode, &inputPath, &outputPath);
+	int argParseResult = parseAgrs(argc, argv, &mode, &maxMode, &timeBudget, &inputPath, &outputPath);
 
 	if (argParseResult != 0) {
 		return argParseResult;
@@ -220,7 +619,7 @@ int main(int argc, char ** argv) {
 
 			free(inBuff);
 			free(outBuff);
-			return decompressionResult;
+			return EXIT_CODEC_FAILED;
 		}
 	}
 
@@ -235,18 +634,49 @@ int main(int argc, char ** argv) {
 			inBuffSize = outBuffSize;
 		}
 
-		outBuffSize = 0x10000;
+		outBuffSize = LZKN1_COMPRESS_BOUND(inBuffSize);
 		outBuff = malloc(outBuffSize);
 
-		lz_error compressionResult = 
-			lzkn1_compress(inBuff, inBuffSize, outBuff, outBuffSize, &compressedSize);
+		lz_error compressionResult;
+
+		if (maxMode) {
+			lzkn1_strategy bestStrategy;
+			lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+			compressionResult = ctx
+				? lzkn1_compress_max_ctx(ctx, inBuff, inBuffSize, outBuff, outBuffSize, &compressedSize, &bestStrategy)
+				: LZ_ALLOC_FAILED;
+
+			if (compressionResult == 0) {
+				printf("Best result: %s strategy, %ld bytes\n", lzkn1_strategy_name(bestStrategy), (long)compressedSize);
+			}
+
+			lzkn1_destroy_ctx(ctx);
+		}
+		else if (timeBudget >= 0) {
+			lzkn1_strategy bestStrategy;
+			lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+			compressionResult = ctx
+				? lzkn1_compress_timed(ctx, inBuff, inBuffSize, outBuff, outBuffSize, &compressedSize, (uint32_t)timeBudget, &bestStrategy)
+				: LZ_ALLOC_FAILED;
+
+			if (compressionResult == 0) {
+				printf("Best result: %s strategy, %ld bytes\n", lzkn1_strategy_name(bestStrategy), (long)compressedSize);
+			}
+
+			lzkn1_destroy_ctx(ctx);
+		}
+		else {
+			compressionResult = lzkn1_compress(inBuff, inBuffSize, outBuff, outBuffSize, &compressedSize);
+		}
 
 		if (compressionResult != 0) {
 			fprintf(stderr, "Compression failed with return code %X\n", compressionResult);
 
 			free(inBuff);
 			free(outBuff);
-			return compressionResult;
+			return EXIT_CODEC_FAILED;
 		}
 
 		// Alter buffer size so only the compressed portion of the steam is written
@@ -0,0 +1,322 @@
+
+/* ================================================================================= *
+ * Konami's LZSS variant 1 (LZKN1) compressor/decompressor							 *
+ * CPython extension module															 *
+ *																					 *
+ * (c) 2020, Vladikcomper															 *
+ * ================================================================================= */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#include "lzkn.h"
+
+/* Module-level exception, raised on compression and decompression errors */
+static PyObject * lzknError = NULL;
+
+/* Contexts are cached per thread and freed when the thread exits */
+static pthread_key_t ctxKey;
+
+static void destroyThreadCtx(void * ctx) {
+	lzkn1_destroy_ctx(ctx);
+}
+
+/*
+ * Returns the calling thread's context, creating it on the first use
+ */
+static lzkn1_ctx * getThreadCtx(void) {
+	lzkn1_ctx * ctx = pthread_getspecific(ctxKey);
+
+	if (!ctx) {
+		ctx = lzkn1_create_ctx();
+
+		if (ctx && pthread_setspecific(ctxKey, ctx) != 0) {
+			lzkn1_destroy_ctx(ctx);
+			ctx = NULL;
+		}
+	}
+
+	return ctx;
+}
+
+/*
+ * Parses strategy name, "max" selects portfolio compression
+ */
+static int parseStrategy(const char * name, int * strategy) {
+	if (strcmp(name, "max") == 0) {
+		*strategy = LZKN1_STRATEGY_COUNT;
+		return 0;
+	}
+
+	for (int i = 0; i < LZKN1_STRATEGY_COUNT; ++i) {
+		if (strcmp(name, lzkn1_strategy_name(i)) == 0) {
+			*strategy = i;
+			return 0;
+		}
+	}
+
+	PyErr_Format(PyExc_ValueError, "unknown strategy \"%s\"", name);
+	return -1;
+}
+
+/*
+ * Compresses to the given buffer with the GIL released
+ */
+static lz_error compressBuffer(const Py_buffer * input, int strategy, uint8_t * outBuff, size_t outBuffSize, size_t * compressedSize) {
+	lz_error result;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	lzkn1_ctx * ctx = getThreadCtx();
+
+	if (!ctx) {
+		result = LZ_ALLOC_FAILED;
+	}
+	else if (strategy == LZKN1_STRATEGY_COUNT) {
+		result = lzkn1_compress_max_ctx(ctx, input->buf, input->len, outBuff, outBuffSize, compressedSize, NULL);
+	}
+	else {
+		result = lzkn1_compress_ctx(ctx, strategy, input->buf, input->len, outBuff, outBuffSize, compressedSize);
+	}
+
+	Py_END_ALLOW_THREADS
+
+	return result;
+}
+
+/*
+ * Decompresses to the given buffer with the GIL released
+ */
+static lz_error decompressBuffer(const Py_buffer * input, uint8_t * outBuff, size_t outBuffSize, size_t * decompressedSize) {
+	lz_error result;
+
+	Py_BEGIN_ALLOW_THREADS
+
+	lzkn1_ctx * ctx = getThreadCtx();
+
+	result = ctx
+		? lzkn1_decompress_ctx(ctx, input->buf, input->len, outBuff, outBuffSize, decompressedSize)
+		: LZ_ALLOC_FAILED;
+
+	Py_END_ALLOW_THREADS
+
+	return result;
+}
+
+static PyObject * raiseError(const char * operation, lz_error result) {
+	if (result & LZ_ALLOC_FAILED) {
+		return PyErr_NoMemory();
+	}
+
+	PyObject * code = PyLong_FromUnsignedLong(result);
+	PyObject * message = PyUnicode_FromFormat("%s failed with return code %X", operation, result);
+
+	if (code && message) {
+		PyObject * exception = PyObject_CallFunctionObjArgs(lzknError, message, NULL);
+
+		if (exception) {
+			PyObject_SetAttrString(exception, "code", code);
+			PyErr_SetObject(lzknError, exception);
+			Py_DECREF(exception);
+		}
+	}
+
+	Py_XDECREF(code);
+	Py_XDECREF(message);
+
+	return NULL;
+}
+
+/*
+ * lzkn.compress(data, strategy="greedy") -> bytes
+ */
+static PyObject * lzkn_compress(PyObject * self, PyObject * args, PyObject * kwargs) {
+	static char * keywords[] = { "data", "strategy", NULL };
+
+	Py_buffer input;
+	const char * strategyName = "greedy";
+	int strategy;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|s:compress", keywords, &input, &strategyName)) {
+		return NULL;
+	}
+
+	if ((parseStrategy(strategyName, &strategy) != 0) || (input.len > 0xFFFF)) {
+		if (!PyErr_Occurred()) {
+			PyErr_SetString(PyExc_ValueError, "data exceeds 65535 bytes");
+		}
+		PyBuffer_Release(&input);
+		return NULL;
+	}
+
+	// Compress directly into the resulting object, then shrink it to fit
+	PyObject * output = PyBytes_FromStringAndSize(NULL, LZKN1_COMPRESS_BOUND(input.len));
+
+	if (!output) {
+		PyBuffer_Release(&input);
+		return NULL;
+	}
+
+	size_t compressedSize = 0;
+	lz_error result = compressBuffer(&input, strategy, (uint8_t *)PyBytes_AS_STRING(output), PyBytes_GET_SIZE(output), &compressedSize);
+
+	PyBuffer_Release(&input);
+
+	if (result != 0) {
+		Py_DECREF(output);
+		return raiseError("Compression", result);
+	}
+
+	_PyBytes_Resize(&output, compressedSize);
+
+	return output;
+}
+
+/*
+ * lzkn.compress_into(data, out, strategy="greedy") -> int
+ */
+static PyObject * lzkn_compress_into(PyObject * self, PyObject * args, PyObject * kwargs) {
+	static char * keywords[] = { "data", "out", "strategy", NULL };
+
+	Py_buffer input, output;
+	const char * strategyName = "greedy";
+	int strategy;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "y*w*|s:compress_into", keywords, &input, &output, &strategyName)) {
+		return NULL;
+	}
+
+	if ((parseStrategy(strategyName, &strategy) != 0) || (input.len > 0xFFFF)) {
+		if (!PyErr_Occurred()) {
+			PyErr_SetString(PyExc_ValueError, "data exceeds 65535 bytes");
+		}
+		PyBuffer_Release(&input);
+		PyBuffer_Release(&output);
+		return NULL;
+	}
+
+	size_t compressedSize = 0;
+	lz_error result = compressBuffer(&input, strategy, output.buf, output.len, &compressedSize);
+
+	PyBuffer_Release(&input);
+	PyBuffer_Release(&output);
+
+	if (result != 0) {
+		return raiseError("Compression", result);
+	}
+
+	return PyLong_FromSize_t(compressedSize);
+}
+
+/*
+ * lzkn.decompress(data) -> bytes
+ */
+static PyObject * lzkn_decompress(PyObject * self, PyObject * args) {
+	Py_buffer input;
+
+	if (!PyArg_ParseTuple(args, "y*:decompress", &input)) {
+		return NULL;
+	}
+
+	if (input.len < 2) {
+		PyBuffer_Release(&input);
+		return raiseError("Decompression", LZ_INBUFF_OVERFLOW);
+	}
+
+	// Uncompressed size is known from the header, so decompress directly into the resulting object
+	const uint8_t * header = input.buf;
+	PyObject * output = PyBytes_FromStringAndSize(NULL, (header[0] << 8) | header[1]);
+
+	if (!output) {
+		PyBuffer_Release(&input);
+		return NULL;
+	}
+
+	size_t decompressedSize = 0;
+	lz_error result = decompressBuffer(&input, (uint8_t *)PyBytes_AS_STRING(output), PyBytes_GET_SIZE(output), &decompressedSize);
+
+	PyBuffer_Release(&input);
+
+	if (result != 0) {
+		Py_DECREF(output);
+		return raiseError("Decompression", result);
+	}
+
+	return output;
+}
+
+/*
+ * lzkn.decompress_into(data, out) -> int
+ */
+static PyObject * lzkn_decompress_into(PyObject * self, PyObject * args) {
+	Py_buffer input, output;
+
+	if (!PyArg_ParseTuple(args, "y*w*:decompress_into", &input, &output)) {
+		return NULL;
+	}
+
+	size_t decompressedSize = 0;
+	lz_error result = decompressBuffer(&input, output.buf, output.len, &decompressedSize);
+
+	PyBuffer_Release(&input);
+	PyBuffer_Release(&output);
+
+	if (result != 0) {
+		return raiseError("Decompression", result);
+	}
+
+	return PyLong_FromSize_t(decompressedSize);
+}
+
+static PyMethodDef lzknMethods[] = {
+	{ "compress", (PyCFunction)(void(*)(void))lzkn_compress, METH_VARARGS | METH_KEYWORDS,
+		"compress(data, strategy=\"greedy\") -> bytes\n\n"
+		"Compresses a bytes-like object (up to 65535 bytes) to LZKN1.\n"
+		"Strategy is one of \"greedy\", \"lazy\", \"optimal\", \"mode2\", \"raw\" or \"max\"." },
+	{ "compress_into", (PyCFunction)(void(*)(void))lzkn_compress_into, METH_VARARGS | METH_KEYWORDS,
+		"compress_into(data, out, strategy=\"greedy\") -> int\n\n"
+		"Compresses to a writable bytes-like object, returns compressed size." },
+	{ "decompress", lzkn_decompress, METH_VARARGS,
+		"decompress(data) -> bytes\n\n"
+		"Decompresses LZKN1 data from a bytes-like object." },
+	{ "decompress_into", lzkn_decompress_into, METH_VARARGS,
+		"decompress_into(data, out) -> int\n\n"
+		"Decompresses to a writable bytes-like object, returns decompressed size." },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef lzknModule = {
+	PyModuleDef_HEAD_INIT,
+	"lzkn",
+	"Konami's LZSS variant 1 (LZKN1) compressor/decompressor.\n\n"
+	"All functions release the GIL while working, so they scale across threads.",
+	-1,
+	lzknMethods
+};
+
+PyMODINIT_FUNC PyInit_lzkn(void) {
+	if (pthread_key_create(&ctxKey, destroyThreadCtx) != 0) {
+		return PyErr_NoMemory();
+	}
+
+	PyObject * module = PyModule_Create(&lzknModule);
+
+	if (!module) {
+		return NULL;
+	}
+
+	lzknError = PyErr_NewException("lzkn.error", PyExc_ValueError, NULL);
+	Py_XINCREF(lzknError);
+
+	if (!lzknError || PyModule_AddObject(module, "error", lzknError) != 0) {
+		Py_XDECREF(lzknError);
+		Py_CLEAR(lzknError);
+		Py_DECREF(module);
+		return NULL;
+	}
+
+	return module;
+}
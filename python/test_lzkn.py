@@ -0,0 +1,80 @@
+# ================================================================================= #
+# Konami's LZSS variant 1 (LZKN1) compressor/decompressor							#
+# CPython extension module tests													#
+#																					#
+# (c) 2020, Vladikcomper															#
+# ================================================================================= #
+
+import random
+import unittest
+from concurrent.futures import ThreadPoolExecutor
+
+import lzkn
+
+STRATEGIES = ("greedy", "lazy", "optimal", "mode2", "raw", "max")
+
+def make_data(seed, size):
+	""" Generates data with byte runs, similar to the fuzzy tests in test.c """
+	rng = random.Random(seed)
+	data = bytearray()
+	while len(data) < size:
+		data += bytes([rng.randrange(256)]) * (rng.randrange(2, 128) if rng.random() > 0.3 else 1)
+	return bytes(data[:size])
+
+
+class RoundTripTests(unittest.TestCase):
+
+	def test_strategies(self):
+		for size in (0, 1, 4, 1000, 0xFFFF):
+			data = make_data(size, size)
+			for strategy in STRATEGIES:
+				with self.subTest(size=size, strategy=strategy):
+					self.assertEqual(lzkn.decompress(lzkn.compress(data, strategy=strategy)), data)
+
+	def test_buffer_types(self):
+		data = make_data(1, 500)
+		compressed = lzkn.compress(data)
+		self.assertEqual(lzkn.compress(bytearray(data)), compressed)
+		self.assertEqual(lzkn.compress(memoryview(data)), compressed)
+		self.assertEqual(lzkn.decompress(memoryview(compressed)), data)
+
+	def test_into(self):
+		data = make_data(2, 3000)
+		out = bytearray(len(data) + len(data) // 8 + 4)
+		size = lzkn.compress_into(data, out, strategy="optimal")
+		self.assertEqual(bytes(out[:size]), lzkn.compress(data, strategy="optimal"))
+
+		decompressed = bytearray(len(data))
+		self.assertEqual(lzkn.decompress_into(memoryview(out)[:size], decompressed), len(data))
+		self.assertEqual(decompressed, data)
+
+	def test_threads(self):
+		inputs = [make_data(seed, 20000) for seed in range(32)]
+		with ThreadPoolExecutor(max_workers=8) as pool:
+			compressed = list(pool.map(lzkn.compress, inputs))
+			self.assertEqual(list(pool.map(lzkn.decompress, compressed)), inputs)
+
+
+class ErrorTests(unittest.TestCase):
+
+	def test_oversized_input(self):
+		with self.assertRaises(ValueError):
+			lzkn.compress(bytes(0x10000))
+
+	def test_unknown_strategy(self):
+		with self.assertRaises(ValueError):
+			lzkn.compress(b"data", strategy="fastest")
+
+	def test_truncated_stream(self):
+		compressed = lzkn.compress(make_data(3, 1000))
+		with self.assertRaises(lzkn.error) as context:
+			lzkn.decompress(compressed[:-1])
+		self.assertNotEqual(context.exception.code, 0)
+
+	def test_small_output_buffer(self):
+		with self.assertRaises(lzkn.error):
+			lzkn.decompress_into(lzkn.compress(b"x" * 100), bytearray(10))
+
+
+if __name__ == "__main__":
+	unittest.main()
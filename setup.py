@@ -0,0 +1,23 @@
+# ================================================================================= #
+# Konami's LZSS variant 1 (LZKN1) compressor/decompressor							#
+# CPython extension module build script												#
+#																					#
+# (c) 2020, Vladikcomper															#
+# ================================================================================= #
+
+from setuptools import setup, Extension
+
+setup(
+	name="lzkn",
+	version="1.7.0",
+	description="Konami's LZSS variant 1 (LZKN1) compressor/decompressor",
+	ext_modules=[
+		Extension(
+			"lzkn",
+			sources=["python/lzknmodule.c", "include/lzkn.c"],
+			include_dirs=["include"],
+			extra_compile_args=["-pthread"],
+			extra_link_args=["-pthread"],
+		),
+	],
+)
@@ -7,9 +7,14 @@
  * ================================================================================= */
 
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "lzkn.h"
 
@@ -28,6 +33,8 @@ typedef struct {
 
 #define MAKE_TEST_ENTRY(ptr) { .dataSize = sizeof(ptr), .data = ptr }
 
+#define MAX(a,b)	((a) > (b) ? (a) : (b))
+
 
 /* Define test data */
 const uint8_t _test0[] = { 0 };
@@ -179,42 +186,106 @@ int runStaticTests() {
 }
 
 /*
- * Runs fuzzy tests
+ * Compresses data with every parse strategy and in portfolio mode, validates the results
  */
-int runFuzzyTests() {
+int validateStrategies(const uint8_t * sourceData, size_t sourceDataSize) {
 
-	const size_t randomBufferSize = 0xFFFF;
-	const size_t numTests = 100;
+	const size_t compressedBufferSize = LZKN1_COMPRESS_BOUND(sourceDataSize);
+	uint8_t * compressedData = malloc(compressedBufferSize);
+	uint8_t * optimalData = malloc(compressedBufferSize);
+	size_t compressedSizes[LZKN1_STRATEGY_COUNT];
 
-	uint8_t * randomBuffer = malloc(randomBufferSize);
+	for (int strategy = 0; strategy <= LZKN1_STRATEGY_COUNT; ++strategy) {
+		const int isMaxMode = (strategy == LZKN1_STRATEGY_COUNT);
+		size_t compressedSize;
+		lzkn1_strategy bestStrategy = LZKN1_STRATEGY_COUNT;
 
-	#define PROBABILITY(x) 		(rand() % 100) > (x)
-	#define RAND_RANGE(a,b) 	(a) + (rand() % ((b) - (a)))
-	#define MIN(a,b) 			(a) < (b) ? (a) : (b)
+		lz_error compressionResult = isMaxMode
+			? lzkn1_compress_max(sourceData, sourceDataSize, compressedData, compressedBufferSize, &compressedSize, &bestStrategy)
+			: lzkn1_compress_strategy(strategy, sourceData, sourceDataSize, compressedData, compressedBufferSize, &compressedSize);
 
-	for (size_t testId = 0; testId < numTests; ++testId) {
-		printf("TEST %ld... ", testId);
-		size_t buffPos;
-		// Fill in random buffer
-		for (buffPos = 0; buffPos < randomBufferSize; ) {
-			const uint8_t byteValue = rand();
-			const int byteShouldRepeat = PROBABILITY(30);
-
-			if (byteShouldRepeat) {
-				const size_t suggestedRepeatCount = RAND_RANGE(2,128);
-				const size_t byteRepeatCount = MIN(suggestedRepeatCount, randomBufferSize - buffPos);
-
-				for (size_t i = 0; i < byteRepeatCount; ++i) {
-					randomBuffer[buffPos++] = byteValue;
-				}
+		if (compressionResult != 0) {
+			printf("FAIL: %s compression returned %X\n", isMaxMode ? "max" : lzkn1_strategy_name(strategy), compressionResult);
+			free(compressedData);
+			free(optimalData);
+			return -1;
+		}
+
+		uint8_t * decompressedData = NULL;
+		size_t decompressedSize;
+
+		lz_error decompressionResult =
+			lzkn1_decompress(compressedData, compressedSize, &decompressedData, &decompressedSize);
+
+		if ((decompressionResult != 0) || (decompressedSize != sourceDataSize) || (memcmp(sourceData, decompressedData, sourceDataSize) != 0)) {
+			printf("FAIL: %s strategy doesn't round-trip (code %X)\n", isMaxMode ? "max" : lzkn1_strategy_name(strategy), decompressionResult);
+			free(compressedData);
+			free(optimalData);
+			free(decompressedData);
+			return -2;
+		}
+
+		free(decompressedData);
+
+		if (isMaxMode) {
+			// Portfolio result should be the optimal one, byte for byte, even if another strategy ties
+			if ((bestStrategy != LZKN1_STRATEGY_OPTIMAL) || (compressedSize != compressedSizes[LZKN1_STRATEGY_OPTIMAL])
+					|| (memcmp(compressedData, optimalData, compressedSize) != 0)) {
+				printf("FAIL: max mode picked %s strategy (%ld bytes)\n", lzkn1_strategy_name(bestStrategy), compressedSize);
+				free(compressedData);
+				free(optimalData);
+				return -3;
 			}
-			else {
-				randomBuffer[buffPos++] = byteValue;
+		}
+		else {
+			compressedSizes[strategy] = compressedSize;
+
+			if (strategy == LZKN1_STRATEGY_OPTIMAL) {
+				memcpy(optimalData, compressedData, compressedSize);
 			}
 		}
+	}
+
+	free(compressedData);
+	free(optimalData);
+
+	// No heuristic should beat the optimal parse
+	for (int strategy = 0; strategy < LZKN1_STRATEGY_COUNT; ++strategy) {
+		if (compressedSizes[strategy] < compressedSizes[LZKN1_STRATEGY_OPTIMAL]) {
+			printf("FAIL: %s strategy beats optimal (%ld < %ld)\n", lzkn1_strategy_name(strategy), compressedSizes[strategy], compressedSizes[LZKN1_STRATEGY_OPTIMAL]);
+			return -4;
+		}
+	}
+
+	printf("PASS: Uncompressed: %ld, greedy: %ld, lazy: %ld, optimal: %ld, mode2: %ld, raw: %ld\n", sourceDataSize,
+		compressedSizes[LZKN1_STRATEGY_GREEDY], compressedSizes[LZKN1_STRATEGY_LAZY], compressedSizes[LZKN1_STRATEGY_OPTIMAL],
+		compressedSizes[LZKN1_STRATEGY_MODE2], compressedSizes[LZKN1_STRATEGY_RAW]);
+
+	return 0;
+
+}
+
+/*
+ * Runs parse strategy tests on the pre-defined data
+ */
+int runStrategyTests() {
 
-		// Test if the buffer recompresses properly
-		int result = validateDataRecompression(randomBuffer, randomBufferSize);
+	// Unknown strategies should be rejected as such
+	uint8_t compressedData[16];
+	size_t compressedSize;
+	lz_error invalidResult = lzkn1_compress_strategy(LZKN1_STRATEGY_COUNT, (const uint8_t *)"", 0, compressedData, sizeof(compressedData), &compressedSize);
+
+	if (invalidResult != LZ_INVALID_ARGUMENT) {
+		printf("FAIL: unknown strategy returned %X\n", invalidResult);
+		return -1;
+	}
+
+	for (size_t testId = 0; testId < sizeof(testData)/sizeof(testData[0]); ++testId ) {
+		printf("TEST %ld... ", testId);
+
+		const testEntry* entry = &testData[testId];
+
+		int result = validateStrategies(entry->data, entry->dataSize);
 
 		if (result != 0) {
 			return result;
@@ -222,22 +293,898 @@ int runFuzzyTests() {
 
 	}
 
-	free(randomBuffer);
+	return 0;
+}
+
+/*
+ * Runs context API tests: a single context is reused for every entry
+ */
+int runContextTests() {
+
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+	if (!ctx) {
+		printf("FAIL: lzkn1_create_ctx() returned NULL\n");
+		return -1;
+	}
+
+	int result = 0;
+	uint8_t * compressedData = malloc(0x10000);
+	uint8_t * referenceData = malloc(0x10000);
+	uint8_t * decompressedData = malloc(0x10000);
+
+	for (size_t testId = 0; (testId < sizeof(testData)/sizeof(testData[0])) && (result == 0); ++testId) {
+		printf("TEST %ld... ", testId);
+
+		const testEntry* entry = &testData[testId];
+
+		for (int strategy = 0; (strategy < LZKN1_STRATEGY_COUNT) && (result == 0); ++strategy) {
+			size_t compressedSize, referenceSize, decompressedSize;
+
+			// Contexts should give the same result as one-shot functions
+			lz_error compressionResult = lzkn1_compress_ctx(ctx, strategy, entry->data, entry->dataSize, compressedData, 0x10000, &compressedSize);
+			lz_error referenceResult = lzkn1_compress_strategy(strategy, entry->data, entry->dataSize, referenceData, 0x10000, &referenceSize);
+
+			if ((compressionResult != 0) || (referenceResult != 0) || (compressedSize != referenceSize) || (memcmp(compressedData, referenceData, compressedSize) != 0)) {
+				printf("FAIL: %s strategy mismatch with a context (codes %X, %X)\n", lzkn1_strategy_name(strategy), compressionResult, referenceResult);
+				result = -1;
+				break;
+			}
+
+			lz_error decompressionResult = lzkn1_decompress_ctx(ctx, compressedData, compressedSize, decompressedData, 0x10000, &decompressedSize);
+
+			if ((decompressionResult != 0) || (decompressedSize != entry->dataSize) || (memcmp(decompressedData, entry->data, decompressedSize) != 0)) {
+				printf("FAIL: lzkn1_decompress_ctx() returned %X\n", decompressionResult);
+				result = -2;
+				break;
+			}
+
+			// Truncated streams should be rejected rather than read out of bounds
+			decompressionResult = lzkn1_decompress_ctx(ctx, compressedData, compressedSize - 1, decompressedData, 0x10000, &decompressedSize);
+
+			if (decompressionResult == 0) {
+				printf("FAIL: lzkn1_decompress_ctx() accepted a truncated stream\n");
+				result = -3;
+				break;
+			}
+		}
+
+		// Portfolio compression should give the same result with a reused context
+		if (result == 0) {
+			size_t compressedSize, referenceSize;
+			lzkn1_strategy bestStrategy, referenceStrategy;
+
+			lz_error compressionResult = lzkn1_compress_max_ctx(ctx, entry->data, entry->dataSize, compressedData, 0x10000, &compressedSize, &bestStrategy);
+			lz_error referenceResult = lzkn1_compress_max(entry->data, entry->dataSize, referenceData, 0x10000, &referenceSize, &referenceStrategy);
+
+			if ((compressionResult != 0) || (referenceResult != 0) || (compressedSize != referenceSize) || (memcmp(compressedData, referenceData, compressedSize) != 0)) {
+				printf("FAIL: portfolio mismatch with a context (codes %X, %X)\n", compressionResult, referenceResult);
+				result = -4;
+			}
+		}
+
+		if (result == 0) {
+			printf("PASS\n");
+		}
+
+		lzkn1_reset_ctx(ctx);
+	}
+
+	lzkn1_destroy_ctx(ctx);
+	free(compressedData);
+	free(referenceData);
+	free(decompressedData);
+
+	return result;
+}
+
+/*
+ * Runs verification tests: "lzkn1_verify" should report the size and checksum of
+ * the original data and reject broken streams with the same codes as "lzkn1_decompress_ctx"
+ */
+int runVerifyTests() {
+
+	// Known Adler-32 value
+	if (lzkn1_checksum((const uint8_t *)"Wikipedia", 9) != 0x11E60398) {
+		printf("FAIL: lzkn1_checksum() returned %08X\n", lzkn1_checksum((const uint8_t *)"Wikipedia", 9));
+		return -1;
+	}
+
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+
+	if (!ctx) {
+		printf("FAIL: lzkn1_create_ctx() returned NULL\n");
+		return -1;
+	}
+
+	int result = 0;
+	uint8_t * compressedData = malloc(0x10000);
+	uint8_t * decompressedData = malloc(0x10000);
+
+	for (size_t testId = 0; (testId < sizeof(testData)/sizeof(testData[0])) && (result == 0); ++testId) {
+		printf("TEST %ld... ", testId);
+
+		const testEntry* entry = &testData[testId];
+		const uint32_t expectedChecksum = lzkn1_checksum(entry->data, entry->dataSize);
+		const uint32_t wrongChecksum = expectedChecksum ^ 1;
+		size_t compressedSize, verifiedSize, decompressedSize;
+		uint32_t checksum;
+
+		lzkn1_compress(entry->data, entry->dataSize, compressedData, 0x10000, &compressedSize);
+
+		lz_error verifyResult = lzkn1_verify(compressedData, compressedSize, &expectedChecksum, &verifiedSize, &checksum);
+
+		if ((verifyResult != 0) || (verifiedSize != entry->dataSize) || (checksum != expectedChecksum)) {
+			printf("FAIL: lzkn1_verify() returned %X, %ld bytes, checksum %08X\n", verifyResult, verifiedSize, checksum);
+			result = -2;
+			break;
+		}
+
+		verifyResult = lzkn1_verify(compressedData, compressedSize, &wrongChecksum, &verifiedSize, &checksum);
+
+		if (verifyResult != LZ_CHECKSUM_MISMATCH) {
+			printf("FAIL: lzkn1_verify() returned %X for a wrong checksum\n", verifyResult);
+			result = -3;
+			break;
+		}
+
+		// Every truncation should fail the same way as a full decompression
+		for (size_t truncatedSize = 0; truncatedSize < compressedSize; ++truncatedSize) {
+			verifyResult = lzkn1_verify(compressedData, truncatedSize, NULL, &verifiedSize, &checksum);
+			lz_error decompressionResult = lzkn1_decompress_ctx(ctx, compressedData, truncatedSize, decompressedData, 0x10000, &decompressedSize);
+
+			if ((verifyResult == 0) || (verifyResult != decompressionResult)) {
+				printf("FAIL: lzkn1_verify() returned %X, lzkn1_decompress_ctx() returned %X for %ld bytes\n", verifyResult, decompressionResult, truncatedSize);
+				result = -4;
+				break;
+			}
+		}
+
+		if (result == 0) {
+			printf("PASS\n");
+		}
+	}
+
+	lzkn1_destroy_ctx(ctx);
+	free(compressedData);
+	free(decompressedData);
+
+	return result;
+}
+
+/*
+ * Runs time-bounded compression tests: zero budget should still give a valid stream,
+ * a generous one should reach the optimal result
+ */
+int runTimedTests() {
+
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+	uint8_t * compressedData = malloc(0x10000);
+	uint8_t * decompressedData = malloc(0x10000);
+	int result = 0;
+
+	const uint32_t timeBudgets[] = { 0, 10000 };
+
+	for (size_t testId = 0; (testId < sizeof(testData)/sizeof(testData[0])) && (result == 0); ++testId) {
+		printf("TEST %ld... ", testId);
+
+		const testEntry* entry = &testData[testId];
+		size_t optimalSize;
+
+		lzkn1_compress_strategy(LZKN1_STRATEGY_OPTIMAL, entry->data, entry->dataSize, compressedData, 0x10000, &optimalSize);
+
+		for (int i = 0; (i < sizeof(timeBudgets)/sizeof(timeBudgets[0])) && (result == 0); ++i) {
+			size_t compressedSize, decompressedSize;
+			lzkn1_strategy bestStrategy;
+
+			lz_error compressionResult = lzkn1_compress_timed(ctx, entry->data, entry->dataSize, compressedData, 0x10000, &compressedSize, timeBudgets[i], &bestStrategy);
+			lz_error decompressionResult = (compressionResult != 0) ? compressionResult :
+				lzkn1_decompress_ctx(ctx, compressedData, compressedSize, decompressedData, 0x10000, &decompressedSize);
+
+			if ((decompressionResult != 0) || (decompressedSize != entry->dataSize) || (memcmp(decompressedData, entry->data, decompressedSize) != 0)) {
+				printf("FAIL: %d ms budget doesn't round-trip (code %X)\n", timeBudgets[i], decompressionResult);
+				result = -1;
+			}
+			else if ((timeBudgets[i] > 0) && (compressedSize != optimalSize)) {
+				printf("FAIL: %d ms budget gives %ld bytes (optimal is %ld)\n", timeBudgets[i], compressedSize, optimalSize);
+				result = -2;
+			}
+		}
+
+		if (result == 0) {
+			printf("PASS\n");
+		}
+	}
+
+	lzkn1_destroy_ctx(ctx);
+	free(compressedData);
+	free(decompressedData);
+
+	return result;
+}
+
+/* ================================================================================= *
+ * Boundary encoding tests															 *
+ * ================================================================================= */
+
+/* Hand-written compressed stream, along with the data it should decompress to */
+typedef struct {
+	uint8_t stream[0x1000];
+	size_t streamSize;
+	size_t descFieldPos;
+	int descFieldBit;
+	uint8_t expected[0x1000];
+	size_t expectedSize;
+} streamWriter;
+
+static void streamBegin(streamWriter * writer, size_t uncompressedSize) {
+	writer->stream[0] = uncompressedSize >> 8;
+	writer->stream[1] = uncompressedSize & 0xFF;
+	writer->streamSize = 2;
+	writer->descFieldBit = 8;
+	writer->expectedSize = 0;
+}
+
+static void streamPushBit(streamWriter * writer, int bit) {
+	if (writer->descFieldBit == 8) {
+		writer->descFieldPos = writer->streamSize++;
+		writer->stream[writer->descFieldPos] = 0;
+		writer->descFieldBit = 0;
+	}
+
+	writer->stream[writer->descFieldPos] |= bit << writer->descFieldBit++;
+}
+
+static void streamRaw(streamWriter * writer, uint8_t value) {
+	streamPushBit(writer, 0);
+	writer->stream[writer->streamSize++] = value;
+	writer->expected[writer->expectedSize++] = value;
+}
+
+static void streamRawRun(streamWriter * writer, size_t size, uint8_t firstValue) {
+	streamPushBit(writer, 1);
+	writer->stream[writer->streamSize++] = 0xC0 | (size - 8);
+
+	for (size_t i = 0; i < size; ++i) {
+		writer->stream[writer->streamSize++] = firstValue + i;
+		writer->expected[writer->expectedSize++] = firstValue + i;
+	}
+}
+
+static void streamCopy(streamWriter * writer, size_t disp, size_t size) {
+	streamPushBit(writer, 1);
+
+	if ((size <= 5) && (disp <= 15)) {
+		writer->stream[writer->streamSize++] = 0x80 | ((size - 2) << 4) | disp;
+	}
+	else {
+		writer->stream[writer->streamSize++] = ((disp & 0x300) >> 3) | (size - 3);
+		writer->stream[writer->streamSize++] = disp & 0xFF;
+	}
+
+	for (size_t i = 0; i < size; ++i, ++writer->expectedSize) {
+		writer->expected[writer->expectedSize] = writer->expected[writer->expectedSize - disp];
+	}
+}
+
+static void streamEnd(streamWriter * writer) {
+	streamPushBit(writer, 1);
+	writer->stream[writer->streamSize++] = 0x1F;
+}
+
+/*
+ * Decodes hand-written stream with both decompressors and checks the result
+ */
+static int validateStream(const char * name, const streamWriter * writer, lzkn1_ctx * ctx) {
+	printf("TEST %s... ", name);
+
+	uint8_t * decompressedData = NULL;
+	size_t decompressedSize;
+
+	lz_error decompressionResult = lzkn1_decompress((uint8_t *)writer->stream, writer->streamSize, &decompressedData, &decompressedSize);
+
+	if ((decompressionResult != 0) || (decompressedSize != writer->expectedSize) || (memcmp(decompressedData, writer->expected, decompressedSize) != 0)) {
+		printf("FAIL: lzkn1_decompress() returned %X\n", decompressionResult);
+		free(decompressedData);
+		return -1;
+	}
+
+	uint8_t ctxDecompressedData[0x1000];
+
+	decompressionResult = lzkn1_decompress_ctx(ctx, writer->stream, writer->streamSize, ctxDecompressedData, sizeof(ctxDecompressedData), &decompressedSize);
+
+	if ((decompressionResult != 0) || (decompressedSize != writer->expectedSize) || (memcmp(ctxDecompressedData, writer->expected, decompressedSize) != 0)) {
+		printf("FAIL: lzkn1_decompress_ctx() returned %X\n", decompressionResult);
+		free(decompressedData);
+		return -2;
+	}
+
+	free(decompressedData);
+
+	// Compressor should handle the same data as well
+	int result = validateDataRecompression(writer->expected, writer->expectedSize);
+
+	return result;
+}
+
+/*
+ * Runs boundary encoding tests: the largest displacements, copy sizes and raw runs
+ */
+int runBoundaryTests() {
+
+	static streamWriter writer;
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+	int result = 0;
+
+	// Raw runs of the minimum (8) and maximum (71) size
+	streamBegin(&writer, 8 + 71 + 1);
+	streamRawRun(&writer, 8, 0x00);
+	streamRawRun(&writer, 71, 0x10);
+	streamRaw(&writer, 0xAA);
+	streamEnd(&writer);
+	result |= validateStream("raw runs 8 and 71", &writer, ctx);
+
+	// Mode 1 at the maximum displacement (1023) and copy size (33)
+	streamBegin(&writer, 1023 + 33);
+	for (int i = 0; i < 14; ++i) {
+		streamRawRun(&writer, 71, i * 71);
+	}
+	streamRawRun(&writer, 1023 - 14 * 71, 0x55);
+	streamCopy(&writer, 1023, 33);
+	streamEnd(&writer);
+	result |= validateStream("displacement 1023, size 33", &writer, ctx);
+
+	// Mode 1 copy of 34 bytes, only encodable when displacement's high bits are set ($7F flag)
+	streamBegin(&writer, 1023 + 34);
+	for (int i = 0; i < 14; ++i) {
+		streamRawRun(&writer, 71, i * 71);
+	}
+	streamRawRun(&writer, 1023 - 14 * 71, 0x55);
+	streamCopy(&writer, 1023, 34);
+	streamEnd(&writer);
+	result |= validateStream("displacement 1023, size 34", &writer, ctx);
+
+	// The optimal parse should use it too: 256 distinct bytes followed by a 34-byte repeat
+	streamBegin(&writer, 256 + 34);
+	streamRawRun(&writer, 71, 0);
+	streamRawRun(&writer, 71, 71);
+	streamRawRun(&writer, 71, 142);
+	streamRawRun(&writer, 43, 213);
+	streamCopy(&writer, 256, 34);
+	streamEnd(&writer);
+	result |= validateStream("displacement 256, size 34", &writer, ctx);
+
+	{
+		uint8_t compressedData[0x1000];
+		size_t compressedSize;
+
+		printf("TEST optimal parse with size 34... ");
+
+		lz_error compressionResult = lzkn1_compress_ctx(ctx, LZKN1_STRATEGY_OPTIMAL, writer.expected, writer.expectedSize, compressedData, sizeof(compressedData), &compressedSize);
+
+		if ((compressionResult != 0) || (compressedSize > writer.streamSize)) {
+			printf("FAIL: %ld bytes (code %X), expected at most %ld\n", compressedSize, compressionResult, writer.streamSize);
+			result |= -1;
+		}
+		else {
+			printf("PASS: %ld bytes\n", compressedSize);
+		}
+	}
+
+	// Overlapping copies: Mode 1 and Mode 2 at displacement 1
+	streamBegin(&writer, 1 + 33 + 5 + 2);
+	streamRaw(&writer, 0x42);
+	streamCopy(&writer, 1, 33);
+	streamCopy(&writer, 1, 5);
+	streamCopy(&writer, 1, 2);
+	streamEnd(&writer);
+	result |= validateStream("overlapping copies", &writer, ctx);
+
+	// Mode 2 at its boundaries: displacement 15 with size 5 and size 2
+	streamBegin(&writer, 15 + 5 + 2);
+	streamRawRun(&writer, 15, 0x20);
+	streamCopy(&writer, 15, 5);
+	streamCopy(&writer, 15, 2);
+	streamEnd(&writer);
+	result |= validateStream("Mode 2 displacement 15", &writer, ctx);
+
+	// Mode 1 just beyond Mode 2 reach, description field spanning several bytes
+	streamBegin(&writer, 16 + 8 * 3);
+	streamRawRun(&writer, 16, 0x30);
+	for (int i = 0; i < 8; ++i) {
+		streamCopy(&writer, 16, 3);
+	}
+	streamEnd(&writer);
+	result |= validateStream("displacement 16", &writer, ctx);
+
+	// Empty data
+	streamBegin(&writer, 0);
+	streamEnd(&writer);
+	result |= validateStream("empty", &writer, ctx);
+
+	// Unmatched bytes at the end, around the raw run limit
+	static uint8_t tailData[4 + 0x48 + 1];
+	const size_t tailSizes[] = { 70, 71, 72, 73 };
+
+	for (size_t i = 0; i < sizeof(tailSizes) / sizeof(tailSizes[0]); ++i) {
+		printf("TEST %ld unmatched bytes at the end... ", tailSizes[i]);
+
+		tailData[0] = tailData[1] = tailData[2] = tailData[3] = 0xFF;
+		for (size_t j = 0; j < tailSizes[i]; ++j) {
+			tailData[4 + j] = j;
+		}
+
+		result |= validateDataRecompression(tailData, 4 + tailSizes[i]);
+	}
+
+	lzkn1_destroy_ctx(ctx);
+
+	return result;
+}
+
+/* ================================================================================= *
+ * Property tests																	 *
+ * ================================================================================= */
+
+/* Property runner options, set from the command line */
+static uint64_t propertySeed = 0x4C5A4B4E31ULL;
+static size_t propertyCases = 2000;
+static int propertyThreads = 0;				// 0 = number of online CPUs
+static int propertyReplay = 0;
+static uint64_t propertyReplaySeed = 0;
+
+#define PROPERTY_CHECK_RATE		4		// cross-checks and corruption run on every 4th case (and on replay)
+#define PROPERTY_GUARD_SIZE		64		// guard bytes around the output of corrupted stream decoding
+#define PROPERTY_GUARD_VALUE	0xA5
+
+/* Data generators */
+typedef enum { GEN_RUNS, GEN_NOISE, GEN_TEXT, GEN_PERIODIC, GEN_TILES, GEN_SPARSE, GEN_COUNT } dataGenerator;
+
+static const char * generatorNames[GEN_COUNT] = { "runs", "noise", "text", "periodic", "tiles", "sparse" };
+
+/* Sizes which are picked more often, as they hit encoding and buffer boundaries */
+static const size_t edgeSizes[] = { 0, 1, 2, 3, 8, 9, 71, 72, 73, 1023, 1024, 1025, 65534, 65535 };
+
+/* Shared state of the property runner threads */
+typedef struct {
+	pthread_mutex_t mutex;
+	size_t nextCase;
+	size_t numFailures;
+	size_t numBytes;
+} propertyRunner;
+
+/*
+ * SplitMix64 random generator, state is advanced on every call
+ */
+static uint64_t nextRandom(uint64_t * state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+#define RAND_RANGE(state, a, b)		((a) + (nextRandom(state) % ((b) - (a))))
+
+/*
+ * Fills in the buffer with data of the given shape
+ */
+static void generateData(dataGenerator generator, uint64_t * state, uint8_t * buffer, size_t size) {
+
+	static const char * words[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet", "sega", "mega", "drive", "konami", "contra", "hard", "corps", "\n", ", "
+	};
+
+	size_t pos = 0;
+
+	switch (generator) {
+		case GEN_RUNS:
+			// Random bytes, repeated 2..127 times with 70% probability (the original fuzzy tests)
+			while (pos < size) {
+				const uint8_t byteValue = nextRandom(state);
+				size_t repeatCount = ((nextRandom(state) % 100) > 30) ? RAND_RANGE(state, 2, 128) : 1;
+
+				for (; (repeatCount > 0) && (pos < size); --repeatCount) {
+					buffer[pos++] = byteValue;
+				}
+			}
+			break;
+
+		case GEN_NOISE:
+			while (pos < size) {
+				buffer[pos++] = nextRandom(state);
+			}
+			break;
+
+		case GEN_TEXT:
+			while (pos < size) {
+				const char * word = words[nextRandom(state) % (sizeof(words) / sizeof(words[0]))];
+
+				for (; (*word != 0x00) && (pos < size); ++word) {
+					buffer[pos++] = *word;
+				}
+				if (pos < size) {
+					buffer[pos++] = ' ';
+				}
+			}
+			break;
+
+		case GEN_PERIODIC: {
+			// Repeating pattern with periods up to and beyond the window size, sometimes mutated
+			const size_t period = RAND_RANGE(state, 1, 1100);
+
+			for (; (pos < size) && (pos < period); ++pos) {
+				buffer[pos] = nextRandom(state);
+			}
+			for (; pos < size; ++pos) {
+				buffer[pos] = ((nextRandom(state) % 64) == 0) ? (uint8_t)nextRandom(state) : buffer[pos - period];
+			}
+			break;
+		}
+
+		case GEN_TILES: {
+			// 32-byte 4bpp tiles picked from a small pool, like Mega Drive art
+			uint8_t tilePool[16][32];
+			const size_t numTiles = RAND_RANGE(state, 1, 17);
+			const uint8_t numColors = RAND_RANGE(state, 2, 17);
+
+			for (size_t tile = 0; tile < numTiles; ++tile) {
+				for (size_t i = 0; i < 32; ++i) {
+					const uint8_t highPixel = nextRandom(state) % numColors;
+					tilePool[tile][i] = (highPixel << 4) | (nextRandom(state) % numColors);
+				}
+			}
+
+			while (pos < size) {
+				const uint8_t * tile = tilePool[nextRandom(state) % numTiles];
+
+				for (size_t i = 0; (i < 32) && (pos < size); ++i) {
+					buffer[pos++] = tile[i];
+				}
+			}
+			break;
+		}
+
+		case GEN_SPARSE:
+			while (pos < size) {
+				buffer[pos++] = ((nextRandom(state) % 16) == 0) ? (uint8_t)nextRandom(state) : 0x00;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * Runs a single property test case, derived entirely from its seed
+ * 
+ * Checks that:
+ *	-- Every strategy round-trips and stays within "LZKN1_COMPRESS_BOUND";
+ *	-- Greedy strategy gives exactly the same stream as "lzkn1_compress";
+ *	-- Corrupted streams are rejected or decoded within bounds by "lzkn1_decompress_ctx";
+ *	-- "lzkn1_verify" agrees with "lzkn1_decompress_ctx" on valid and corrupted streams.
+ * 
+ * Only the first property is checked on every case, the rest on every
+ * "PROPERTY_CHECK_RATE"-th one. Corrupted streams are decoded from an exactly sized
+ * copy (so sanitizers catch over-reads) to an output surrounded by guard bytes.
+ */
+static int runPropertyCase(lzkn1_ctx * ctx, uint64_t caseSeed, uint8_t * buffers[4], size_t * dataSizePtr, int verbose) {
+
+	uint64_t state = caseSeed;
+
+	const dataGenerator generator = nextRandom(&state) % GEN_COUNT;
+	const lzkn1_strategy strategy = nextRandom(&state) % LZKN1_STRATEGY_COUNT;
+	size_t dataSize;
+
+	if ((nextRandom(&state) % 4) == 0) {
+		dataSize = edgeSizes[nextRandom(&state) % (sizeof(edgeSizes) / sizeof(edgeSizes[0]))];
+	}
+	else {
+		// Log-uniform sizes, so small assets are as common as large ones
+		const size_t sizeBits = RAND_RANGE(&state, 1, 17);
+		dataSize = nextRandom(&state) % ((size_t)1 << sizeBits);
+	}
+
+	uint8_t * sourceData = buffers[0];
+	uint8_t * compressedData = buffers[1];
+	uint8_t * referenceData = buffers[2];
+	uint8_t * decompressedData = buffers[3];
+
+	generateData(generator, &state, sourceData, dataSize);
+	*dataSizePtr = dataSize;
+
+	const int checkAll = verbose || (((caseSeed >> 32) % PROPERTY_CHECK_RATE) == 0);
+
+	if (verbose) {
+		printf("Seed %016llX: %s data, %ld bytes, %s strategy\n", (unsigned long long)caseSeed, generatorNames[generator], dataSize, lzkn1_strategy_name(strategy));
+	}
+
+	#define PROPERTY_FAIL(...) { \
+			printf("FAIL: seed %016llX (%s data, %ld bytes, %s strategy): ", (unsigned long long)caseSeed, generatorNames[generator], dataSize, lzkn1_strategy_name(strategy)); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			return -1; \
+		}
+
+	// Property: strategy round-trips within bounds
+	size_t compressedSize, referenceSize, decompressedSize;
+	lz_error result = lzkn1_compress_ctx(ctx, strategy, sourceData, dataSize, compressedData, LZKN1_COMPRESS_BOUND(dataSize), &compressedSize);
+
+	if (result != 0) {
+		PROPERTY_FAIL("lzkn1_compress_ctx() returned %X", result);
+	}
+
+	result = lzkn1_decompress_ctx(ctx, compressedData, compressedSize, decompressedData, 0x10000, &decompressedSize);
+
+	if ((result != 0) || (decompressedSize != dataSize) || (memcmp(sourceData, decompressedData, dataSize) != 0)) {
+		PROPERTY_FAIL("round-trip failed, lzkn1_decompress_ctx() returned %X", result);
+	}
+
+	if (!checkAll) {
+		return 0;
+	}
+
+	// Property: verification accepts the stream and checksums the original data
+	uint32_t checksum;
+	result = lzkn1_verify(compressedData, compressedSize, NULL, &decompressedSize, &checksum);
+
+	if ((result != 0) || (decompressedSize != dataSize) || (checksum != lzkn1_checksum(sourceData, dataSize))) {
+		PROPERTY_FAIL("lzkn1_verify() returned %X, %ld bytes, checksum %08X", result, decompressedSize, checksum);
+	}
+
+	// Property: greedy strategy matches the one-shot compressor, which decompresses correctly
+	if (strategy == LZKN1_STRATEGY_GREEDY) {
+		result = lzkn1_compress(sourceData, dataSize, referenceData, LZKN1_COMPRESS_BOUND(dataSize), &referenceSize);
+
+		if ((result != 0) || (referenceSize != compressedSize) || (memcmp(referenceData, compressedData, compressedSize) != 0)) {
+			PROPERTY_FAIL("lzkn1_compress() mismatch (code %X, %ld vs %ld bytes)", result, referenceSize, compressedSize);
+		}
+
+		uint8_t * oneShotData = NULL;
+		result = lzkn1_decompress(referenceData, referenceSize, &oneShotData, &decompressedSize);
+
+		if ((result != 0) || (decompressedSize != dataSize) || (memcmp(sourceData, oneShotData, dataSize) != 0)) {
+			free(oneShotData);
+			PROPERTY_FAIL("round-trip failed, lzkn1_decompress() returned %X", result);
+		}
+
+		free(oneShotData);
+	}
+
+	// Property: corrupted streams never decode out of bounds
+	if (compressedSize > 2) {
+		const size_t numCorruptions = RAND_RANGE(&state, 1, 4);
+
+		for (size_t i = 0; i < numCorruptions; ++i) {
+			const size_t corruptedPos = RAND_RANGE(&state, 2, compressedSize);
+			compressedData[corruptedPos] ^= 1 << (nextRandom(&state) % 8);
+		}
+
+		const size_t truncatedSize = (nextRandom(&state) % 2) ? compressedSize : RAND_RANGE(&state, 2, compressedSize);
+		uint8_t * corruptedData = malloc(truncatedSize);
+		uint8_t * outputData = decompressedData + PROPERTY_GUARD_SIZE;
+
+		if (!corruptedData) {
+			PROPERTY_FAIL("out of memory");
+		}
+
+		memcpy(corruptedData, compressedData, truncatedSize);
+		memset(decompressedData, PROPERTY_GUARD_VALUE, dataSize + 2 * PROPERTY_GUARD_SIZE);
+
+		result = lzkn1_decompress_ctx(ctx, corruptedData, truncatedSize, outputData, dataSize, &decompressedSize);
+
+		size_t verifiedSize;
+		lz_error verifyResult = lzkn1_verify(corruptedData, truncatedSize, NULL, &verifiedSize, &checksum);
+
+		free(corruptedData);
+
+		for (size_t i = 0; i < PROPERTY_GUARD_SIZE; ++i) {
+			if ((decompressedData[i] != PROPERTY_GUARD_VALUE) || (outputData[dataSize + i] != PROPERTY_GUARD_VALUE)) {
+				PROPERTY_FAIL("corrupted stream was decoded outside of the output buffer");
+			}
+		}
+
+		if ((result == 0) && (decompressedSize != dataSize)) {
+			PROPERTY_FAIL("corrupted stream decoded to %ld bytes", decompressedSize);
+		}
+
+		if ((verifyResult != result) || ((result == 0) && (checksum != lzkn1_checksum(outputData, decompressedSize)))) {
+			PROPERTY_FAIL("lzkn1_verify() returned %X, lzkn1_decompress_ctx() returned %X on a corrupted stream", verifyResult, result);
+		}
+	}
+
+	#undef PROPERTY_FAIL
 
 	return 0;
+}
 
+/*
+ * Property runner thread: claims cases one by one until none are left
+ */
+static void * runPropertyThread(void * arg) {
+
+	propertyRunner * runner = arg;
+	lzkn1_ctx * ctx = lzkn1_create_ctx();
+	uint8_t * buffers[4];
+
+	for (int i = 0; i < 4; ++i) {
+		buffers[i] = malloc(LZKN1_COMPRESS_BOUND(0x10000));
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&runner->mutex);
+		const size_t caseId = runner->nextCase++;
+		pthread_mutex_unlock(&runner->mutex);
+
+		if (caseId >= propertyCases) {
+			break;
+		}
+
+		// Case seeds are derived from the base seed, so any failure can be replayed alone
+		uint64_t seedState = propertySeed + caseId;
+		const uint64_t caseSeed = nextRandom(&seedState);
+		size_t dataSize = 0;
+
+		const int result = runPropertyCase(ctx, caseSeed, buffers, &dataSize, 0);
+
+		pthread_mutex_lock(&runner->mutex);
+		runner->numFailures += (result != 0);
+		runner->numBytes += dataSize;
+		pthread_mutex_unlock(&runner->mutex);
+	}
+
+	for (int i = 0; i < 4; ++i) {
+		free(buffers[i]);
+	}
+	lzkn1_destroy_ctx(ctx);
+
+	return NULL;
+}
+
+/*
+ * Runs property tests in parallel and reports the throughput
+ */
+int runPropertyTests() {
+
+	// Replay a single case if requested
+	if (propertyReplay) {
+		lzkn1_ctx * ctx = lzkn1_create_ctx();
+		uint8_t * buffers[4];
+		size_t dataSize;
+
+		for (int i = 0; i < 4; ++i) {
+			buffers[i] = malloc(LZKN1_COMPRESS_BOUND(0x10000));
+		}
+
+		int result = runPropertyCase(ctx, propertyReplaySeed, buffers, &dataSize, 1);
+
+		if (result == 0) {
+			printf("PASS\n");
+		}
+
+		for (int i = 0; i < 4; ++i) {
+			free(buffers[i]);
+		}
+		lzkn1_destroy_ctx(ctx);
+
+		return result;
+	}
+
+	const int numThreads = (propertyThreads > 0) ? propertyThreads : lzkn1_cpu_count();
+	pthread_t * threads = malloc(numThreads * sizeof(pthread_t));
+	propertyRunner runner = { .nextCase = 0, .numFailures = 0, .numBytes = 0 };
+	struct timespec startTime, endTime;
+
+	printf("Seed %016llX, %ld cases, %d threads\n", (unsigned long long)propertySeed, propertyCases, numThreads);
+
+	pthread_mutex_init(&runner.mutex, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+	int numStarted = 0;
+
+	for (; numStarted < numThreads; ++numStarted) {
+		if (pthread_create(&threads[numStarted], NULL, runPropertyThread, &runner) != 0) {
+			break;
+		}
+	}
+
+	if (numStarted == 0) {
+		runPropertyThread(&runner);
+	}
+	for (int i = 0; i < numStarted; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	pthread_mutex_destroy(&runner.mutex);
+	free(threads);
+
+	const double elapsed = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+	printf("%s: %ld cases (%ld failed), %.1f MB in %.2f s, %.0f cases/sec\n",
+		runner.numFailures ? "FAIL" : "PASS", propertyCases, runner.numFailures,
+		runner.numBytes / 1e6, elapsed, propertyCases / MAX(elapsed, 1e-9));
+
+	if (runner.numFailures) {
+		printf("Replay failed cases with: test -r <seed>\n");
+		return -1;
+	}
+
+	return 0;
 }
 
 /* Define test execution sequence ... */
 const testExecutorData testsExecutorsSequence[] = {
 	{ .name = "Static tests", .function = runStaticTests },
-	{ .name = "Fuzzy tests", .function = runFuzzyTests }
+	{ .name = "Strategy tests", .function = runStrategyTests },
+	{ .name = "Context tests", .function = runContextTests },
+	{ .name = "Verification tests", .function = runVerifyTests },
+	{ .name = "Time-bounded tests", .function = runTimedTests },
+	{ .name = "Boundary tests", .function = runBoundaryTests },
+	{ .name = "Property tests", .function = runPropertyTests }
 };
 
+/*
+ * Parses command line options:
+ *	-s <seed>	Base seed for property tests (hexadecimal)
+ *	-n <cases>	Number of property test cases
+ *	-j <threads>	Number of property test threads (default: number of CPUs)
+ *	-r <seed>	Replay a single property test case (hexadecimal seed from a failure report)
+ */
+int parseOptions(int argc, char ** argv) {
+
+	for (int i = 1; i < argc; ++i) {
+		const char * option = argv[i];
+		const char * value = (i + 1 < argc) ? argv[++i] : NULL;
+		char * valueEnd = NULL;
+
+		if (value == NULL) {
+			fprintf(stderr, "ERROR: Option \"%s\" expects a value.\n", option);
+			return 1;
+		}
+
+		if (strcmp(option, "-s") == 0) {
+			propertySeed = strtoull(value, &valueEnd, 16);
+		}
+		else if (strcmp(option, "-n") == 0) {
+			propertyCases = strtoull(value, &valueEnd, 10);
+		}
+		else if (strcmp(option, "-j") == 0) {
+			propertyThreads = strtol(value, &valueEnd, 10);
+		}
+		else if (strcmp(option, "-r") == 0) {
+			propertyReplay = 1;
+			propertyReplaySeed = strtoull(value, &valueEnd, 16);
+		}
+		else {
+			fprintf(stderr, "ERROR: Unknown option \"%s\".\n", option);
+			return 1;
+		}
+
+		if (*valueEnd != 0x00) {
+			fprintf(stderr, "ERROR: Invalid value \"%s\" for option \"%s\".\n", value, option);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 /*
  * Main loop 
  */
-int main() {
+int main(int argc, char ** argv) {
+
+	if (parseOptions(argc, argv) != 0) {
+		return 1;
+	}
+
+	// Replaying a property test case skips everything else
+	if (propertyReplay) {
+		return runPropertyTests();
+	}
 
 	for (int i = 0; i < sizeof(testsExecutorsSequence) / sizeof(testsExecutorsSequence[0]); ++i) {
 		const testExecutorData * testExecutor = &testsExecutorsSequence[i];